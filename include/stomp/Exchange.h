@@ -3,6 +3,7 @@
 
 
 #include <set>
+#include <map>
 #include <deque>
 #include <string>
 
@@ -10,6 +11,8 @@
 #include <openstats/StatsClient_Interface.h>
 
 #include "StompMessage.h"
+#include "Subscription.h"
+#include "SubscriptionTrie.h"
 
 namespace stomp {
 
@@ -23,9 +26,20 @@ namespace stomp {
 
   class Subscription;
   class StompPeer;
+  class Exchange;
+
+  // whoever runs the exchanges, told when one has work so the idle ones
+  // are never visited
+  class ExchangeScheduler_Interface {
+    public:
+      virtual ~ExchangeScheduler_Interface() { }
+      virtual void onRunnable(Exchange *exch) = 0;
+  }; // class ExchangeScheduler_Interface
+
   class Exchange : public openframe::OpenFrame_Abstract,
                    public openframe::Refcount,
-                   public openstats::StatsClient_Interface {
+                   public openstats::StatsClient_Interface,
+                   public SubscriptionCredit_Interface {
     public:
       typedef std::set<Subscription *> bind_t;
       typedef bind_t::iterator bind_itr;
@@ -35,8 +49,26 @@ namespace stomp {
       typedef std::deque<StompMessage *> queue_t;
       typedef queue_t::size_type queue_st;
 
-      typedef std::vector<Subscription *> list_t;
-      typedef list_t::size_type list_st;
+      typedef SubscriptionTrie::list_t list_t;
+      typedef SubscriptionTrie::list_st list_st;
+
+      // matches for a destination, valid while generation is current
+      typedef struct {
+        bool cached;
+        size_t generation;
+        list_t subs;
+      } route_t;
+      typedef std::map<std::string, route_t> routes_t;
+      typedef routes_t::iterator routes_itr;
+      typedef routes_t::size_type routes_st;
+
+      // queued messages bucketed by the second they expire, entries hold
+      // no reference, a message is taken out of its bucket as it leaves
+      // _sendq, see StompMessage::expiry_at()
+      typedef std::vector<StompMessage *> expiryBucket_t;
+      typedef std::map<time_t, expiryBucket_t> expiries_t;
+      typedef expiries_t::iterator expiries_itr;
+      typedef expiries_t::size_type expiries_st;
 
       enum exchangeTypeEnum {
         exchangeTypeDirect	= 0,
@@ -47,11 +79,12 @@ namespace stomp {
 
       static const time_t kDefaultExpireInterval;
       static const time_t kDefaultRecoverDeadInterval;
-      static const time_t kDefaultDeferredInterval;
       static const time_t kDefaultExchangeStatsInterval;
       static const time_t kDefaultStatsIntval;
       static const size_t kDefaultByteLimit;
       static const size_t kDefaultExpireLimit;
+      static const size_t kMaxRouteCacheSize;
+      static const size_t kDefaultWeight;
 
       Exchange(const std::string &key);
       virtual ~Exchange();
@@ -64,6 +97,7 @@ namespace stomp {
       void post(StompMessage *smesg);
 
       bool bind(Subscription *sub);
+      virtual bool is_bindable(Subscription *sub) const { return true; }
       bool unbind(Subscription *sub);
       bind_st unbind(const string &id);
       bind_st unbind(StompPeer *peer);
@@ -90,13 +124,28 @@ namespace stomp {
         return *this;
       } // set_expire_limit
 
-      Exchange &set_deferred_interval(const time_t ex) {
-        _deferred_interval = double(ex / 1e6);
+      // a parked exchange has a backlog nobody can take, it is woken by
+      // whatever creates capacity instead of polling for it
+      inline bool is_parked() const { return _parked; }
+
+      // runnable exchanges have queued work, everything else they do is
+      // on a clock and next_deadline() says when, 0 if never
+      inline void set_scheduler(ExchangeScheduler_Interface *scheduler) { _scheduler = scheduler; }
+      virtual bool is_runnable() const { return (!_sendq.empty() && !_parked); }
+      time_t next_deadline() const;
+
+      // shares of each dispatch pass, the deficit is what the scheduler
+      // still owes this exchange from earlier passes
+      Exchange &set_weight(const size_t weight) {
+        _weight = (weight ? weight : 1);
         return *this;
-      } // set_deferred_delay
-      inline time_t deferred_interval() const { return _deferred_interval; }
-      inline void set_delayed_dispatch() { _last_dispatch = openframe::Stopwatch::Now(); }
-      inline time_t is_next_dispatch() const { return _last_dispatch < openframe::Stopwatch::Now() - _deferred_interval; }
+      } // set_weight
+      inline size_t weight() const { return _weight; }
+      inline size_t deficit() const { return _deficit; }
+      inline void set_deficit(const size_t deficit) { _deficit = deficit; }
+
+      // a sub holding back our queue has sendq room again
+      virtual void onCredit(Subscription *sub) { wake(); }
 
       virtual const std::string toString() const;
       virtual size_t dispatch(const size_t limit);
@@ -107,22 +156,38 @@ namespace stomp {
       bind_st bind_size() const { return _binds.size(); }
       queue_st sendq_size() const { return _sendq.size(); }
       queue_st unackd_size() const { return _unackd.size(); }
-      queue_st deferd_size() const { return _deferd.size(); }
       bool try_stats();
 
     protected:
-      list_st find_matches(const string &key, list_t &ret);
+      list_st find_matches(StompMessage *smesg, list_t &ret);
+      const list_t &routes(const string &key);
       size_t inc_bytes(StompMessage *smesg);
       size_t dec_bytes(StompMessage *smesg);
+      void queued(StompMessage *smesg);
+      void unfile_expiry(StompMessage *smesg);
+      bool next_message(StompMessage *&smesg);
+      bool peek_message(StompMessage *&smesg);
+      void compact_expired();
       void dispatched(StompMessage *smesg);
       void expire(StompMessage *smesg);
+      void park();
+      void wake();
+      void runnable();
+      virtual void onBind(Subscription *sub) { }
+      virtual void onUnbind(Subscription *sub) { }
       void init_stats(const time_t report_interval=0, const bool startup=false);
 
       exchangeTypeEnum _type;
 
       bind_t _binds;
+      SubscriptionTrie _routes;		// _binds indexed by key
+      routes_t _route_cache;
+      size_t _bind_generation;		// bumped whenever _binds changes
+      bool _parked;
+      ExchangeScheduler_Interface *_scheduler;
+      expiries_t _expiries;
+      size_t _num_expired_queued;	// expired but still in _sendq
       queue_t _sendq;
-      queue_t _deferd;
       queue_t _unackd;
 
       size_t _num_posts;
@@ -146,11 +211,11 @@ namespace stomp {
       time_t _expire_interval;
       size_t _expire_limit;
       time_t _last_expire;
-      double _deferred_interval;
-      double _last_dispatch;
       size_t _byte_limit;
       time_t _recover_dead_interval;
       time_t _last_recover_dead;
+      size_t _weight;
+      size_t _deficit;
   }; // class Exchange
 
   std::ostream &operator<<(std::ostream &ss, const Exchange *exch);
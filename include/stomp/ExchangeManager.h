@@ -2,12 +2,16 @@
 #define __MODULE_STOMP_EXCHANGEMANAGER_H
 
 #include <map>
+#include <set>
+#include <deque>
 #include <string>
+#include <tr1/unordered_map>
 
 #include <openframe/openframe.h>
 #include <openstats/StatsClient_Interface.h>
 
 #include "Exchange.h"
+#include "SubscriptionTrie.h"
 
 namespace stomp {
 
@@ -22,19 +26,47 @@ namespace stomp {
   class StompPeer;
   class ExchangeManager : public openframe::OpenFrame_Abstract,
                           public openframe::Refcount,
-                          public openstats::StatsClient_Interface {
+                          public openstats::StatsClient_Interface,
+                          public ExchangeScheduler_Interface {
     public:
       typedef std::map<std::string, Exchange *> exchange_t;
       typedef exchange_t::iterator exchange_itr;
       typedef exchange_t::const_iterator exchange_citr;
       typedef exchange_t::size_type exchange_st;
 
+      // direct exchanges again by key, hashed for the send path
+      typedef std::tr1::unordered_map<std::string, Exchange *> direct_t;
+      typedef direct_t::iterator direct_itr;
+      typedef direct_t::const_iterator direct_citr;
+
       typedef std::set<Subscription *> subscriptions_t;
       typedef subscriptions_t::iterator subscriptions_itr;
       typedef subscriptions_t::const_iterator subscriptions_citr;
       typedef subscriptions_t::size_type subscriptions_st;
 
+      // exchanges each stored subscription is bound to
+      typedef std::map<Subscription *, std::set<Exchange *> > bindings_t;
+      typedef bindings_t::iterator bindings_itr;
+      typedef bindings_t::const_iterator bindings_citr;
+      typedef bindings_t::size_type bindings_st;
+
+      // exchanges with queued work, each one listed at most once
+      typedef std::deque<Exchange *> runq_t;
+      typedef runq_t::size_type runq_st;
+
+      // exchanges waiting on a deadline, _timer_at holds the one that
+      // counts and any other entry for the exchange is stale
+      typedef std::multimap<time_t, Exchange *> timers_t;
+      typedef timers_t::iterator timers_itr;
+      typedef std::map<Exchange *, time_t> timerAt_t;
+      typedef timerAt_t::iterator timerAt_itr;
+
+      typedef std::map<std::string, size_t> weights_t;
+      typedef weights_t::iterator weights_itr;
+      typedef weights_t::const_iterator weights_citr;
+
       static const size_t kDispatchLimit;
+      static const double kDefaultDispatchBudget;
 
       ExchangeManager();
       virtual ~ExchangeManager();
@@ -52,17 +84,39 @@ namespace stomp {
 
       bool store_subscription(Subscription *sub);
       bool forget_subscription(Subscription *sub);
-      Subscription *find_subscription(StompPeer *peer, const std::string &id);
+      Subscription *find_subscription(StompPeer *peer, const StompSlice &id);
       void forget_subscriptions();
       void forget_subscriptions(StompPeer *peer);
-      void match_subscriptions();
 
       void dispatch_exchanges();
+      ExchangeManager &set_dispatch_budget(const double budget) {
+        _dispatch_budget = budget;
+        return *this;
+      } // set_dispatch_budget
+      inline double dispatch_budget() const { return _dispatch_budget; }
+      ExchangeManager &set_weight(const std::string &key, const size_t weight);
+      runq_st runq_size() const { return _runq.size(); }
+      virtual void onRunnable(Exchange *exch);
 
     protected:
+      bool bind(Exchange *exch, Subscription *sub);
+      exchange_st unbind(Subscription *sub);
+      subscriptions_st bind_subscriptions(Exchange *exch);
+      void schedule(Exchange *exch);
+      void unschedule(Exchange *exch);
+
     private:
       exchange_t _exchanges;
+      direct_t _direct;
       subscriptions_t _subscriptions;
+      SubscriptionTrie _index;		// _subscriptions by key
+      bindings_t _bindings;
+      runq_t _runq;
+      std::set<Exchange *> _runnable;	// members of _runq
+      timers_t _timers;
+      timerAt_t _timer_at;
+      weights_t _weights;		// kept for exchanges not made yet
+      double _dispatch_budget;		// seconds per pass, 0 for none
   }; // class Exchange
 
   //std::ostream &operator<<(std::ostream &ss, const Exchange *exch);
@@ -0,0 +1,48 @@
+#ifndef __MODULE_STOMP_EXCHANGE_DIRECT_H
+#define __MODULE_STOMP_EXCHANGE_DIRECT_H
+
+
+#include <set>
+#include <queue>
+#include <string>
+
+#include <openframe/openframe.h>
+
+#include "Exchange.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // Point to point by exact key: only subscriptions naming the exchange
+  // key itself are bound, never globs, so every bind receives every
+  // message and nothing is matched per message.
+  class Exchange_Direct : public Exchange {
+    public:
+      Exchange_Direct(const std::string &key);
+      virtual ~Exchange_Direct();
+
+      virtual const std::string toString() const;
+      virtual size_t onDispatch(const size_t limit);
+      virtual bool is_bindable(Subscription *sub) const;
+
+    protected:
+    private:
+  }; // class Exchange
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
@@ -3,12 +3,14 @@
 
 
 #include <set>
+#include <deque>
 #include <queue>
 #include <string>
 
 #include <openframe/openframe.h>
 
 #include "Exchange.h"
+#include "Subscription.h"
 
 namespace stomp {
 
@@ -20,17 +22,32 @@ namespace stomp {
  ** Structures                                                           **
  **************************************************************************/
 
+  // Every subscription bound here matched the exchange key, which is also
+  // the destination of every message posted, so consumers are picked from
+  // a ring of the ones with prefetch room instead of routing each message.
   class Exchange_Fanout : public Exchange {
     public:
+      typedef std::deque<Subscription *> ring_t;
+      typedef ring_t::iterator ring_itr;
+      typedef ring_t::size_type ring_st;
+
       Exchange_Fanout(const std::string &key);
       virtual ~Exchange_Fanout();
 
       virtual const std::string toString() const;
       virtual size_t onDispatch(const size_t limit);
+      virtual void onCredit(Subscription *sub);
+
+      ring_st ready_size() const { return _ready.size(); }
 
     protected:
+      virtual void onBind(Subscription *sub);
+      virtual void onUnbind(Subscription *sub);
+      Subscription *next_ready(StompMessage *smesg);
+      bool is_wanted(StompMessage *smesg) const;
+
     private:
-      unsigned int _index;
+      ring_t _ready;		// round robin order, parked subs are not in it
   }; // class Exchange
 
 /**************************************************************************
@@ -0,0 +1,86 @@
+#ifndef __MODULE_STOMP_EXCHANGE_HEADERS_H
+#define __MODULE_STOMP_EXCHANGE_HEADERS_H
+
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <openframe/openframe.h>
+
+#include "Exchange.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // Routes on message headers instead of the destination. The header
+  // rules of every bind are inverted into name -> value -> binds, so a
+  // message costs one lookup per header it carries and each hit counts
+  // towards the binds waiting on it, a bind matches once enough of its
+  // rules were hit. Binds without rules take everything.
+  class Exchange_Headers : public Exchange {
+    public:
+      typedef struct {
+        Subscription *sub;		// NULL while the slot is free
+        size_t required;		// hits needed to match
+        size_t hits;
+        size_t message;			// message the hits count for
+      } slot_t;
+      typedef std::vector<slot_t> slots_t;
+      typedef slots_t::size_type slots_st;
+
+      typedef std::vector<slots_st> slotList_t;
+      typedef slotList_t::iterator slotList_itr;
+
+      typedef std::map<std::string, slotList_t> values_t;
+      typedef values_t::iterator values_itr;
+
+      typedef struct {
+        size_t message;			// last message carrying this name
+        values_t values;
+      } name_t;
+      typedef std::map<std::string, name_t> index_t;
+      typedef index_t::iterator index_itr;
+      typedef index_t::size_type index_st;
+
+      Exchange_Headers(const std::string &key);
+      virtual ~Exchange_Headers();
+
+      virtual const std::string toString() const;
+      virtual size_t onDispatch(const size_t limit);
+
+      index_st index_size() const { return _index.size(); }
+
+    protected:
+      virtual void onBind(Subscription *sub);
+      virtual void onUnbind(Subscription *sub);
+      const list_t &match(StompMessage *smesg);
+
+    private:
+      slots_t _slots;
+      slotList_t _free;			// slots to reuse
+      slotList_t _unconditional;	// binds without rules
+      std::map<Subscription *, slots_st> _slot_of;
+      index_t _index;
+      size_t _message;			// numbers the messages matched
+      list_t _matched;			// reused by match()
+      std::string _scratch;		// likewise
+  }; // class Exchange
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
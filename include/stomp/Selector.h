@@ -0,0 +1,167 @@
+#ifndef LIBSTOMP_SELECTOR_H
+#define LIBSTOMP_SELECTOR_H
+
+#include <string>
+#include <vector>
+
+#include <openframe/openframe.h>
+
+#include "StompHeaders.h"
+#include "StompSlice.h"
+#include "Stomp_Exception.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // A JMS style message selector, e.g.
+  //
+  //   type = 'alert' AND (priority >= 5 OR region IN ('eu', 'us'))
+  //
+  // Identifiers name headers, comparisons, [NOT] LIKE, [NOT] IN,
+  // [NOT] BETWEEN and IS [NOT] NULL are supported along with AND, OR, NOT
+  // and SQL's three valued logic, a missing header is NULL. There is no
+  // arithmetic so '-' may be part of a header name.
+  //
+  // The expression is compiled once into postfix code, match() runs it
+  // over a stack sized at compile time and reads header values in place,
+  // so nothing is allocated per message.
+  class Selector {
+    public:
+      static const size_t kMaxLength;
+      static const size_t kMaxNesting;
+
+      Selector(const std::string &expr);
+      virtual ~Selector();
+
+      const bool match(const StompHeaders *headers) const;
+      inline const std::string &expr() const { return _expr; }
+      inline size_t size() const { return _code.size(); }
+      // values match() needs room for at once
+      inline size_t depth() const { return _max_depth; }
+
+    protected:
+      enum opcodeEnum {
+        opHeader		= 0,
+        opString		= 1,
+        opNumber		= 2,
+        opBoolean		= 3,
+        opEqual			= 4,
+        opNotEqual		= 5,
+        opLess			= 6,
+        opLessEqual		= 7,
+        opGreater		= 8,
+        opGreaterEqual		= 9,
+        opLike			= 10,
+        opIn			= 11,
+        opBetween		= 12,
+        opIsNull		= 13,
+        opNot			= 14,
+        opAnd			= 15,
+        opOr			= 16
+      };
+
+      enum valueTypeEnum {
+        valueNull		= 0,
+        valueBoolean		= 1,
+        valueNumber		= 2,
+        valueString		= 3
+      };
+
+      // LIKE patterns are split into these at compile time
+      enum likeEnum {
+        likeChar		= 0,
+        likeOne			= 1,	// _
+        likeAny			= 2	// %
+      };
+
+      typedef struct {
+        likeEnum type;
+        char c;
+      } like_t;
+
+      typedef struct {
+        opcodeEnum op;
+        bool negate;				// NOT LIKE, NOT IN, ...
+        bool boolean;
+        double number;
+        std::string str;			// header name or literal
+        std::vector<std::string> list;		// IN
+        std::vector<like_t> like;		// LIKE
+      } op_t;
+
+      typedef struct {
+        valueTypeEnum type;
+        bool boolean;
+        double number;
+        StompSlice str;
+      } value_t;
+
+      enum tokenEnum {
+        tokenEnd		= 0,
+        tokenIdent		= 1,
+        tokenString		= 2,
+        tokenNumber		= 3,
+        tokenSymbol		= 4
+      };
+
+      typedef struct {
+        tokenEnum type;
+        std::string text;
+        double number;
+        size_t pos;
+      } token_t;
+
+      // ### Compiler ###
+      void next_token();
+      bool is_keyword(const char *word) const;
+      bool is_symbol(const char *symbol) const;
+      void expect_keyword(const char *word);
+      void expect_symbol(const char *symbol);
+      void fail(const std::string &reason) const;
+      static op_t new_op(const opcodeEnum code);
+      void emit(const op_t &op, const int depth);
+      void parse_or();
+      void parse_and();
+      void parse_not();
+      void parse_predicate();
+      void parse_operand();
+      std::string parse_string();
+      void compile_like(const std::string &pattern, const char escape, std::vector<like_t> &ret);
+
+      // ### Evaluation ###
+      static bool to_number(const value_t &v, double &ret);
+      static int compare(const value_t &a, const value_t &b, bool &known);
+      static bool like(const StompSlice &str, const std::vector<like_t> &pattern);
+      static void set_logic(value_t &v, const int logic);
+      static int logic(const value_t &v);
+
+    private:
+      std::string _expr;
+      std::vector<op_t> _code;
+      mutable std::vector<value_t> _stack;	// sized by the compiler
+      size_t _depth;
+      size_t _max_depth;
+
+      // only used while compiling
+      size_t _nesting;
+      size_t _pos;
+      token_t _token;
+  }; // class Selector
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
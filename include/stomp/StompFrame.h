@@ -3,9 +3,12 @@
 
 #include <string>
 
+#include <strings.h>
+
 #include <openframe/openframe.h>
 
 #include "StompHeaders.h"
+#include "StompPayload.h"
 #include "Stomp_Exception.h"
 
 namespace stomp {
@@ -40,12 +43,22 @@ namespace stomp {
       };
 
       StompFrame(const string &command, const string &body="");
+      StompFrame(const commandEnum type, const string &body="");
+      StompFrame(const commandEnum type, const char *body, const size_t body_len);
+      StompFrame(const commandEnum type, StompPayload *payload);
       virtual ~StompFrame();
 
+      static commandEnum classify(const char *command, const size_t len);
+      static const string command_str(const commandEnum type);
+
       // ### Public Members ###
-      inline const string command() const { return _command; }
-      inline const string body() const { return _body; }
-      inline const bool is_command(const string &command) const { return (StringTool::toUpper(_command) == command); }
+      inline const string &command() const { return _command; }
+      inline const string &body() const { return _payload->str(); }
+      // shared with anything built from this frame, retain to keep it
+      inline StompPayload *payload() const { return _payload; }
+      inline const bool is_command(const string &command) const {
+        return (command.length() == _command.length() && strncasecmp(command.data(), _command.data(), _command.length()) == 0);
+      } // is_command
       inline const bool is_command(const commandEnum type) const { return (type == _type); }
       inline const commandEnum type() const { return _type; }
       inline const bool requires_resp() const { return _requires_resp; }
@@ -56,24 +69,23 @@ namespace stomp {
       inline const time_t updated() const { return _updated; }
       inline const time_t updated_since() const { return ( time(NULL) - _updated ); }
 
-      virtual const size_t length() { return _body.length(); }
+      virtual const size_t length() { return _payload->length(); }
       virtual const string compile();
+      const size_t compile(string &out);
       virtual const string toString() const;
 
     protected:
       // ### Protected Variables ###
       bool _requires_resp;
       bool _execute_transaction;
+      string _command;
+      StompPayload *_payload;
 
     private:
       // ### Private Variables ###
-      string _command;
-      string _body;
       time_t _created;
       time_t _updated;
       commandEnum _type;
-
-      stringstream _out;
   }; // class StompFrame
 
   std::ostream &operator<<(std::ostream &ss, const StompFrame *frame);
@@ -3,9 +3,12 @@
 
 #include <string>
 
+#include <stdint.h>
+
 #include <openframe/openframe.h>
 
 #include "StompHeader.h"
+#include "StompSlice.h"
 #include "Stomp_Exception.h"
 
 namespace stomp {
@@ -18,32 +21,116 @@ namespace stomp {
  ** Structures                                                           **
  **************************************************************************/
 
-  class StompHeaders : public openframe::Refcount, public stompHeader_t {
+  // Headers are kept in insertion order as name/value slices into one byte
+  // arena, both of which live inline until a frame outgrows them. Headers
+  // defined by the STOMP spec also get a slot indexed by headerEnum.
+  class StompHeaders : public openframe::Refcount {
     public:
+      enum headerEnum {
+        headerDestination	= 0,
+        headerMessageId		= 1,
+        headerSubscription	= 2,
+        headerTransaction	= 3,
+        headerReceipt		= 4,
+        headerReceiptId		= 5,
+        headerId		= 6,
+        headerAck		= 7,
+        headerContentLength	= 8,
+        headerContentType	= 9,
+        headerLogin		= 10,
+        headerPasscode		= 11,
+        headerHeartBeat		= 12,
+        headerMessage		= 13,
+        headerSession		= 14,
+        headerUnknown		= 15
+      };
+
+      static const size_t kInlineHeaders = 8;
+      static const size_t kInlineBytes = 256;
+
       StompHeaders();
       StompHeaders(const std::string &name, const std::string &value);
       virtual ~StompHeaders();
 
       // ### Public Members ###
       StompHeaders &add_header(const std::string &name, const std::string &value);
+      StompHeaders &add_header(const char *name, const size_t name_len, const char *value, const size_t value_len);
+      StompHeaders &add_header(const headerEnum known, const char *name, const size_t name_len, const char *value, const size_t value_len);
+      StompHeaders &add_header(const headerEnum known, const std::string &value);
       StompHeaders &replace_header(const std::string &name, const std::string &value);
       StompHeaders &replace_header(StompHeader *header);
+      StompHeaders &replace_header(const headerEnum known, const std::string &value);
+      StompHeaders &replace_header(const headerEnum known, const char *value, const size_t value_len);
       StompHeaders &copy_headers_from(const StompHeaders *frame);
       StompHeaders &remove_header(const std::string &name);
-      const std::string get_header(const std::string &name);
-      const std::string get_header(const std::string &name, const std::string &def);
-      const bool get_header(const std::string &name, StompHeader *&header);
-      const bool is_header(const std::string &name);
+      const std::string get_header(const std::string &name) const;
+      const std::string get_header(const std::string &name, const std::string &def) const;
+      const std::string get_header(const headerEnum known) const;
+      const std::string get_header(const headerEnum known, const std::string &def) const;
+      const bool is_header(const std::string &name) const;
+      const bool find_header(const char *name, const size_t len, StompSlice &ret) const;
+      inline const bool is_header(const headerEnum known) const { return _slots[known] != kNoSlot; }
+      inline StompSlice header(const headerEnum known) const {
+        return is_header(known) ? header_value(_slots[known]) : StompSlice();
+      } // header
       const std::string headersToString() const;
 
+      inline size_t num_headers() const { return _num_headers; }
+      inline StompSlice header_name(const size_t i) const { return StompSlice(_bytes + _headers[i].name, _headers[i].name_len); }
+      inline StompSlice header_value(const size_t i) const { return StompSlice(_bytes + _headers[i].value, _headers[i].value_len); }
+      inline headerEnum header_known(const size_t i) const { return (headerEnum) _headers[i].known; }
+
+      // bumped on every change, lets callers cache anything derived from headers
+      inline uint32_t version() const { return _version; }
+
+      static headerEnum classify(const char *name, const size_t len);
+      static const std::string header_str(const headerEnum known);
+
     protected:
-      const stompHeaderSize_t headers(ByteData &buf);
+      const size_t headers(ByteData &buf);
       const std::string headers() const;
+      const size_t headers_length() const;
+      const size_t append_headers(std::string &out) const;
 
       // ### Protected Variables ###
       bool _requires_resp;
 
     private:
+      static const uint32_t kNoSlot = 0xffffffff;
+
+      typedef struct {
+        uint32_t hash;
+        uint32_t known;
+        uint32_t name;
+        uint32_t name_len;
+        uint32_t value;
+        uint32_t value_len;
+      } header_t;
+
+      StompHeaders(const StompHeaders &);
+      StompHeaders &operator=(const StompHeaders &);
+
+      static uint32_t hash(const char *name, const size_t len);
+      size_t find(const char *name, const size_t len) const;
+      size_t find(const headerEnum known, const char *name, const size_t len) const;
+      void insert(const headerEnum known, const char *name, const size_t name_len, const char *value, const size_t value_len);
+      void assign(const size_t i, const char *value, const size_t value_len);
+      void erase(const size_t i);
+      uint32_t append(const char *buf, const size_t len);
+      void compact();
+
+      uint32_t _slots[headerUnknown];
+      header_t _inline_headers[kInlineHeaders];
+      header_t *_headers;
+      size_t _num_headers;
+      size_t _max_headers;
+
+      char _inline_bytes[kInlineBytes];
+      char *_bytes;
+      size_t _num_bytes;
+      size_t _max_bytes;
+      size_t _dead_bytes;
+      uint32_t _version;
   }; // class StompHeaders
 
   std::ostream &operator<<(std::ostream &ss, const StompHeaders *headers);
@@ -4,6 +4,8 @@
 #include <string>
 #include <deque>
 
+#include <stdint.h>
+
 #include <openframe/openframe.h>
 
 #include "StompFrame.h"
@@ -20,22 +22,42 @@ namespace stomp {
 
   class StompMessage : public StompFrame {
     public:
+      enum idModeEnum {
+        idModeSequence		= 0,
+        idModeUuid		= 1
+      };
+
+      static const size_t kMaxIdLength = 64;
+      static const size_t kMaxIdPrefixLength = 40;
+
       StompMessage(const std::string &destination, const std::string &body, const time_t inactivity_timeout=0);
       StompMessage(const std::string &destination, const std::string &transaction, const std::string &body, const time_t inactivity_timeout=0);
+      StompMessage(const std::string &destination, StompFrame *frame, const time_t inactivity_timeout=0);
       virtual ~StompMessage();
 
       // ### Public Members ###
-      inline const std::string destination() const { return _destination; }
-      inline const std::string transaction() const { return _transaction; }
-      inline const std::string id() const { return _id; }
-      inline const bool is_id(const std::string &id) { return (id == _id); }
-      inline const std::string body() const { return _body; }
+      // the body lives in StompFrame and the id and transaction in the
+      // header arena, only the routing key is kept apart from the headers
+      inline const std::string &destination() const { return _destination; }
+      inline const std::string transaction() const { return header(headerTransaction).str(); }
+      inline const std::string id() const { return header(headerMessageId).str(); }
+      inline const bool is_id(const std::string &id) const { return header(headerMessageId).is(id); }
       const std::string toString() const;
 
       inline time_t inactivity_timeout() const { return _inactivity_timeout; }
       inline time_t created() const { return _created; }
       inline time_t last_activity() const { return _last_activity; }
       inline bool is_inactive() const { return ( _inactivity_timeout && _last_activity < (time(NULL) - _inactivity_timeout) ); }
+      inline time_t expires_at() const { return ( _inactivity_timeout ? _last_activity + _inactivity_timeout + 1 : 0 ); }
+
+      // where the exchange queue holding the message filed it for expiry,
+      // 0 when it isn't, so it can be taken out when it leaves the queue
+      inline void set_expiry_slot(const time_t at, const size_t slot) { _expiry_at = at; _expiry_slot = slot; }
+      inline time_t expiry_at() const { return _expiry_at; }
+      inline size_t expiry_slot() const { return _expiry_slot; }
+      inline void mark_expired() { _expired = true; }
+      inline void mark_unexpired() { _expired = false; }
+      inline bool is_expired() const { return _expired; }
       inline time_t sent() const { return _sent; }
       inline bool is_sent() const { return (_sent > 0); }
       inline void mark_sent() { _sent = time(NULL); }
@@ -44,18 +66,39 @@ namespace stomp {
       inline unsigned int num_attempts() const { return _num_attempts; }
       static const std::string create_uuid();
 
+      // ids are "<prefix>:<sequence>" unless set to idModeUuid, the
+      // prefix defaults to a uuid made once per process
+      static void set_id_mode(const idModeEnum mode) { _id_mode = mode; }
+      static void set_id_prefix(const std::string &prefix);
+      static const size_t create_id(char *buf);	// buf holds kMaxIdLength
+      static const std::string create_id();
+
+      // appends the wire form of this message as delivered to subscription
+      const size_t compile(const std::string &subscription, std::string &out);
+
     protected:
+      void encode();
 
     private:
-      std::string _destination;
-      std::string _transaction;
-      std::string _id;
-      std::string _body;
+      static idModeEnum _id_mode;
+      static std::string _id_prefix;
+      static uint64_t _id_sequence;
+
+      std::string _destination;		// routing key, not the wire header
       time_t _inactivity_timeout;
       time_t _created;
       time_t _last_activity;
       time_t _sent;
       unsigned int _num_attempts;
+      time_t _expiry_at;
+      size_t _expiry_slot;
+      bool _expired;
+
+      // command and headers serialized once and shared by every delivery,
+      // the per delivery headers and the body are appended behind them
+      std::string _wire;
+      uint32_t _wire_version;
+      bool _wire_ok;
   }; // StompMessage
 
   typedef std::deque<StompMessage *> mesgList_t;
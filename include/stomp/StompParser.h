@@ -6,6 +6,8 @@
 #include <map>
 #include <queue>
 #include <string>
+#include <vector>
+#include <tr1/unordered_map>
 
 #include <openframe/openframe.h>
 #include <openstats/openstats.h>
@@ -13,6 +15,7 @@
 #include "StompServer.h"
 #include "StompFrame.h"
 #include "StompMessage.h"
+#include "StompScanner.h"
 #include "Subscription.h"
 #include "TransactionManager.h"
 
@@ -41,6 +44,9 @@ namespace stomp {
                       virtual public openframe::Refcount {
     public:
       static const time_t kDefaultStatsInterval;
+      static const size_t kDefaultCompactSize;
+      static const size_t kDefaultScanBlockSize;
+      static const size_t kDefaultMaxFrameSize;
 
       StompParser();
       virtual ~StompParser();
@@ -51,7 +57,8 @@ namespace stomp {
       typedef std::queue<StompFrame *> frameQueue_t;
       typedef frameQueue_t::size_type frameQueueSize_t;
 
-      typedef std::map<std::string, Subscription *> subscriptions_t;
+      // keys point at the id each subscription holds
+      typedef std::tr1::unordered_map<StompSlice, Subscription *, StompSliceHash, StompSliceEqual> subscriptions_t;
       typedef subscriptions_t::iterator subscriptions_itr;
       typedef subscriptions_t::const_iterator subscriptions_citr;
       typedef subscriptions_t::size_type subscriptions_st;
@@ -76,12 +83,16 @@ namespace stomp {
       bool is_bound(const std::string &);
       const bool is_match(const std::string &, Subscription *&);
       Subscription *find_bind(const std::string &id);
-      const bool received_ack(const std::string &, const std::string &);
-      const bool received_nack(const std::string &, const std::string &);
+      const bool received_ack(const StompSlice &, const StompSlice &);
+      const bool received_nack(const StompSlice &, const StompSlice &);
 
       bool store_subscription(Subscription *sub);
       bool forget_subscription(Subscription *sub);
-      Subscription *find_subscription(const std::string &id);
+      Subscription *find_subscription(const StompSlice &id);
+
+      // frames, or content-length headers, over this disconnect the peer
+      inline void set_max_frame_size(const size_t max_frame_size) { _max_frame_size = max_frame_size; }
+      inline size_t max_frame_size() const { return _max_frame_size; }
 
       size_t receive(const char *buf, const size_t len);
       const string::size_type transmit(string &);
@@ -108,6 +119,7 @@ namespace stomp {
 
       // ### Protocol Commands ###
       const size_t send_frame(StompFrame *);
+      const size_t send_message(StompMessage *, const std::string &subscription);
       const size_t send_error(const std::string &, const std::string &body="");
       const size_t disconnect_with_error(const std::string &, const std::string &body="");
       virtual bool next_frame(StompFrame *&frame);
@@ -123,9 +135,9 @@ namespace stomp {
       bool nack(const std::string &message_id, const std::string &subscription, StompHeaders *headers=NULL);
       bool abort(const std::string &, StompHeaders *headers=NULL);
       bool message(const std::string &, const std::string &, const std::string &, StompHeaders *headers=NULL);
-      bool receipt(const std::string &, StompHeaders *headers=NULL);
+      bool receipt(const StompSlice &, StompHeaders *headers=NULL);
 
-      bool commit_transaction(const std::string &key);
+      bool commit_transaction(const StompSlice &key);
 
       // ### Stats Pure Virtuals ###
       virtual void onDescribeStats();
@@ -137,15 +149,31 @@ namespace stomp {
       bool _process_body_len();
       bool _process_body_nul();
       bool _process_waitfor_nul();
+      void _process_frame(const size_t body_len, const size_t frame_len);
       void _process_reset();
+      void _process_invalid(const std::string &reason);
+      void _consume(const size_t len);
+      bool _find_boundary(const char c, const size_t from, size_t &ret);
       void _clear_frameq();
       std::string _uniq_id;
 
+      // all offsets are relative to _in_pos, the start of the staged frame
+      typedef struct {
+        StompHeaders::headerEnum known;
+        size_t name;
+        size_t name_len;
+        size_t value;
+        size_t value_len;
+      } stompHeaderSlice_t;
+
       typedef struct {
-        std::string command;
-        std::string body;
-        stompHeader_t headers;
+        size_t line;			// start of the line being parsed
+        size_t scan;			// where the next search resumes
+        size_t command_len;
+        size_t body;
         size_t content_length;
+        bool has_content_length;
+        std::vector<stompHeaderSlice_t> headers;
       } stompStage_t;
 
       // ### Protected Members ###
@@ -161,10 +189,19 @@ namespace stomp {
 
       openframe::OFLock _in_l;
       openframe::OFLock _out_l;
-      openframe::StreamParser _in;
+      std::string _in;
+      size_t _in_pos;
       std::string _out;
+      std::string _encoded;		// reused by send_frame and send_message
+
+      // boundaries are absolute offsets into _in
+      StompScanner::boundaries_t _boundaries;
+      StompScanner::boundaries_st _boundary;
+      size_t _boundary_scan;
 
       frameQueue_t _frameQ;
+      size_t _max_frame_size;
+      bool _discard;			// lost framing, input is dropped until reset()
       stompStageEnum _stage;
       stompStage_t _stagedFrame;
 
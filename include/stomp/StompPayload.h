@@ -0,0 +1,55 @@
+#ifndef LIBSTOMP_STOMPPAYLOAD_H
+#define LIBSTOMP_STOMPPAYLOAD_H
+
+#include <string>
+
+#include <openframe/openframe.h>
+
+#include "StompSlice.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // An immutable, refcounted frame body. The parser creates one per frame
+  // and every later holder of those bytes retains it instead of copying.
+  class StompPayload : public openframe::Refcount {
+    public:
+      StompPayload(const std::string &data);
+      StompPayload(const char *data, const size_t len);
+      virtual ~StompPayload();
+
+      // shared empty body, returned retained
+      static StompPayload *empty();
+      // builds a payload from data, the empty body is shared
+      static StompPayload *create(const char *data, const size_t len);
+
+      inline const std::string &str() const { return _data; }
+      inline const char *data() const { return _data.data(); }
+      inline size_t length() const { return _data.length(); }
+      inline StompSlice slice() const { return StompSlice(_data); }
+
+    protected:
+    private:
+      StompPayload(const StompPayload &);
+      StompPayload &operator=(const StompPayload &);
+
+      const std::string _data;
+  }; // class StompPayload
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
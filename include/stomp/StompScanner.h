@@ -0,0 +1,54 @@
+#ifndef LIBSTOMP_STOMPSCANNER_H
+#define LIBSTOMP_STOMPSCANNER_H
+
+#include <vector>
+#include <string>
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // Finds every frame boundary ('\n' and '\0') in a chunk in one sweep.
+  // SSE2 is the baseline on x86, AVX2 is picked at runtime when the cpu
+  // supports it and everything else falls back to a plain byte loop.
+  class StompScanner {
+    public:
+      typedef std::vector<size_t> boundaries_t;
+      typedef boundaries_t::size_type boundaries_st;
+
+      // appends base + offset of each boundary in buf to ret
+      static boundaries_st scan(const char *buf, const size_t len,
+                                const size_t base, boundaries_t &ret);
+      static const std::string isa();
+
+    protected:
+      typedef boundaries_st (*scanFunc_t)(const char *, const size_t, const size_t, boundaries_t &);
+
+      static scanFunc_t select();
+      static boundaries_st scan_bytes(const char *buf, const size_t len,
+                                      const size_t base, boundaries_t &ret);
+      static boundaries_st scan_sse2(const char *buf, const size_t len,
+                                     const size_t base, boundaries_t &ret);
+      static boundaries_st scan_avx2(const char *buf, const size_t len,
+                                     const size_t base, boundaries_t &ret);
+
+    private:
+      static scanFunc_t _scan;
+  }; // class StompScanner
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
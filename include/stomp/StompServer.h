@@ -99,6 +99,17 @@ namespace stomp {
         _queue_byte_limit = queue_byte_limit;
         return *this;
       } // set_queue_byte_limit
+      // caps every new subscription's sendq, SUBSCRIBE may only ask for a
+      // lower one, 0 for no cap, spill falls back to drop-oldest off queues
+      inline StompServer &set_subscription_limit(const size_t max_bytes, const size_t max_messages,
+                                                 const Subscription::overflowPolicyEnum policy) {
+        _sub_max_bytes = max_bytes;
+        _sub_max_messages = max_messages;
+        _sub_overflow_policy = policy;
+        return *this;
+      } // set_subscription_limit
+      StompServer &set_dispatch_budget(const double budget);
+      StompServer &set_exchange_weight(const std::string &key, const size_t weight);
 
       inline const bool debug() const { return _debug; }
       inline StompServer &debug(const bool debug) {
@@ -144,6 +155,7 @@ namespace stomp {
       void _process_unsubscribe(StompPeer *, StompFrame *);
       void _process_receipt_id(StompPeer *, StompFrame *);
       void _process_disconnect(StompPeer *, StompFrame *);
+      static bool _client_limit(StompFrame *, const std::string &name, const size_t cap, size_t &ret);
       bool _store_transaction(StompPeer *, StompFrame *);
       void _send_queues(StompPeer *);
 
@@ -163,6 +175,9 @@ namespace stomp {
       time_t _time_queue_expire;
       size_t _max_work;
       size_t _queue_byte_limit;
+      size_t _sub_max_bytes;
+      size_t _sub_max_messages;
+      Subscription::overflowPolicyEnum _sub_overflow_policy;
       ExchangeManager *_exch_manager;
 
       struct obj_stats_t {
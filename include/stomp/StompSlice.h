@@ -0,0 +1,79 @@
+#ifndef LIBSTOMP_STOMPSLICE_H
+#define LIBSTOMP_STOMPSLICE_H
+
+#include <string>
+#include <cstring>
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // A pointer and length into bytes owned by someone else, only valid
+  // as long as the owner is not modified.
+  class StompSlice {
+    public:
+      StompSlice() : _data(NULL), _length(0) { }
+      StompSlice(const char *data, const size_t length) : _data(data), _length(length) { }
+      StompSlice(const std::string &str) : _data(str.data()), _length(str.length()) { }
+
+      inline const char *data() const { return _data; }
+      inline size_t length() const { return _length; }
+      inline bool empty() const { return _length == 0; }
+      inline const std::string str() const { return std::string(_data, _length); }
+      inline bool is(const char *data, const size_t length) const {
+        return _length == length && memcmp(_data, data, length) == 0;
+      } // is
+      inline bool is(const std::string &str) const { return is(str.data(), str.length()); }
+
+      // digits only, anything else including a sign or an overflow is invalid
+      inline bool to_size(size_t &ret) const {
+        if (!_length) return false;
+
+        size_t value = 0;
+        for(size_t i=0; i < _length; i++) {
+          if (_data[i] < '0' || _data[i] > '9') return false;
+          size_t digit = _data[i] - '0';
+          if (value > (((size_t) -1) - digit) / 10) return false;
+          value = value * 10 + digit;
+        } // for
+
+        ret = value;
+        return true;
+      } // to_size
+
+    protected:
+    private:
+      const char *_data;
+      size_t _length;
+  }; // class StompSlice
+
+  // for keying hashed containers by slices, whoever fills the container
+  // keeps the bytes alive for as long as the entry exists
+  struct StompSliceHash {
+    size_t operator()(const StompSlice &s) const {
+      size_t h = 2166136261u;
+      for(size_t i=0; i < s.length(); i++) h = (h ^ (unsigned char) s.data()[i]) * 16777619u;
+      return h;
+    } // operator()
+  }; // struct StompSliceHash
+
+  struct StompSliceEqual {
+    bool operator()(const StompSlice &a, const StompSlice &b) const { return a.is(b.data(), b.length()); }
+  }; // struct StompSliceEqual
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
@@ -122,6 +122,13 @@ class StompUnknownCommandId_Exception : public Frame_Exception {
     StompUnknownCommandId_Exception(const uint32_t command_id) throw() : super("unknown command_id; id="+StringTool::char2hex(command_id) ) { }
 }; // class StompUnknownCommandId_Exception
 
+class StompInvalidSelector_Exception : public Stomp_Exception {
+  private:
+    typedef Stomp_Exception super;
+  public:
+    StompInvalidSelector_Exception(const string &reason, const size_t pos) throw() : super("invalid selector; "+reason+" at "+stringify<int>(pos) ) { }
+}; // class StompInvalidSelector_Exception
+
 /**************************************************************************
  ** Macro's                                                              **
  **************************************************************************/
@@ -3,10 +3,16 @@
 
 #include <string>
 #include <deque>
+#include <map>
+#include <vector>
+#include <tr1/unordered_map>
+
+#include <stdint.h>
 
 #include <openframe/openframe.h>
 
 #include "StompMessage.h"
+#include "Selector.h"
 
 namespace stomp {
 
@@ -19,6 +25,17 @@ namespace stomp {
  **************************************************************************/
 
   class StompPeer;
+  class Subscription;
+
+  // Told once when a subscription that ran out of prefetch room, or of
+  // sendq room while spilling, can take messages again, see
+  // Subscription::wait_for_credit().
+  class SubscriptionCredit_Interface {
+    public:
+      virtual ~SubscriptionCredit_Interface() { }
+      virtual void onCredit(Subscription *sub) = 0;
+  }; // class SubscriptionCredit_Interface
+
   class Subscription : public openframe::OpenFrame_Abstract, public openframe::Refcount {
     public:
       enum ackModeEnum {
@@ -27,6 +44,25 @@ namespace stomp {
         ackModeClientIndv	= 2
       };
 
+      // what enqueue() does once _sendq is at its cap
+      enum overflowPolicyEnum {
+        overflowDropOldest	= 0,
+        overflowDropNewest	= 1,
+        overflowDisconnect	= 2,	// drops and disconnects the peer
+        overflowSpill		= 3	// the queue holds on to messages, queues only
+      };
+
+      enum headerMatchEnum {
+        headerMatchAll		= 0,
+        headerMatchAny		= 1
+      };
+
+      // header name to the value it must have, used by headers exchanges
+      typedef std::map<std::string, std::string> headerRules_t;
+      typedef headerRules_t::iterator headerRules_itr;
+      typedef headerRules_t::const_iterator headerRules_citr;
+      typedef headerRules_t::size_type headerRules_st;
+
       typedef std::deque<StompMessage *> queue_t;
       typedef queue_t::iterator queue_itr;
       typedef queue_t::const_iterator queue_citr;
@@ -39,45 +75,111 @@ namespace stomp {
 
       inline Subscription &prefetch(const size_t prefetch) {
         _prefetch = prefetch;
+        credit_returned();
         return *this;
       } // prefetch
       inline const size_t prefetch() const { return _prefetch; }
-      inline const bool prefetch_ok() { return (_prefetch == 0 || _sentq.size() < _prefetch); }
+      inline const bool prefetch_ok() { return (_prefetch == 0 || sentq() < _prefetch); }
 
-      inline const std::string id() const { return _id; }
-      inline const bool is_id(const std::string &id) const { return (id == _id); }
+      // caps _sendq by bytes and count, 0 for no cap
+      inline Subscription &sendq_limit(const size_t max_bytes, const size_t max_messages, const overflowPolicyEnum policy) {
+        _max_sendq_bytes = max_bytes;
+        _max_sendq = max_messages;
+        _overflow_policy = policy;
+        return *this;
+      } // sendq_limit
+      inline const overflowPolicyEnum overflow_policy() const { return _overflow_policy; }
+      inline const bool has_room() const {
+        return ( (_max_sendq == 0 || _sendq.size() < _max_sendq)
+                 && (_max_sendq_bytes == 0 || _sendq_bytes < _max_sendq_bytes) );
+      } // has_room
+      inline const bool is_spilling() const { return (_overflow_policy == overflowSpill && !has_room()); }
+      inline size_t sendq_bytes() const { return _sendq_bytes; }
+      inline size_t num_dropped() const { return _num_dropped; }
+
+      inline const std::string &id() const { return _id; }
+      inline const bool is_id(const StompSlice &id) const { return id.is(_id); }
       inline const bool is_peer(StompPeer *peer) const { return (peer == _peer); }
-      inline const std::string key() const { return _key; }
+      inline const std::string &key() const { return _key; }
       inline const ackModeEnum ack_mode() const { return _ack_mode; }
       const bool match(const std::string &key) const;
       bool try_stats();
 
+      // rules are fixed before the first bind, exchanges index them then,
+      // names match in any case
+      bool add_header_rule(const std::string &name, const std::string &value);
+      inline Subscription &header_match(const headerMatchEnum header_match) {
+        _header_match = header_match;
+        return *this;
+      } // header_match
+      inline const headerMatchEnum header_match() const { return _header_match; }
+      inline const headerRules_t &header_rules() const { return _header_rules; }
+
+      // throws StompInvalidSelector_Exception, an empty expr clears it
+      Subscription &selector(const std::string &expr);
+      inline const bool selects(const StompMessage *smesg) const { return (_selector == NULL || _selector->match(smesg)); }
+
       void bind();
       void unbind();
 
       void enqueue(StompMessage *smesg);
-      size_t dequeue(const std::string &);
-      size_t redeliver(const std::string &);
-      const bool dequeue_for_send(StompMessage *&smesg);
+      size_t dequeue(const StompSlice &);
+      size_t redeliver(const StompSlice &);
+      const bool dequeue_for_send(StompMessage *&smesg);	// caller releases smesg
       void dequeue_all(mesgList_t &ret);
       mesgList_st dequeue_dead(mesgList_t &ret, size_t limit=0);
 
+      void wait_for_credit(SubscriptionCredit_Interface *waiter);
+      void forget_credit(SubscriptionCredit_Interface *waiter);
+
       const std::string toString() const;
       const std::string toStats() const;
 
       inline queue_st sendq() const { return _sendq.size(); }
-      inline queue_st sentq() const { return _sentq.size(); }
+      inline queue_st sentq() const { return _sentq.size() - _num_sent_holes; }
 
     protected:
+      void credit_returned();
+      void dropped();
+
+      // position of the message id in _sentq, found without a scan
+      bool find_sent(const StompSlice &id, queue_st &ret) const;
+      void index_sent(StompMessage *smesg);
+      void unindex_sent(StompMessage *smesg);
+      size_t remove_sent_through(const queue_st pos, const bool redeliver);
+      size_t remove_sent(const queue_st pos, const bool redeliver);
+      void compact_sent();
+
     private:
+      typedef std::vector<SubscriptionCredit_Interface *> waiters_t;
+
+      // keys point at the message-id header of the indexed message, which
+      // _sentq keeps alive for as long as the entry exists
+      typedef std::tr1::unordered_map<StompSlice, uint64_t, StompSliceHash, StompSliceEqual> sentIndex_t;
+      typedef sentIndex_t::iterator sentIndex_itr;
+      typedef sentIndex_t::const_iterator sentIndex_citr;
+
       StompPeer *_peer;
       std::string _id;
       std::string _key;
       ackModeEnum _ack_mode;
       queue_t _deadq;
       queue_t _sendq;
+      size_t _sendq_bytes;
+      size_t _max_sendq_bytes;
+      size_t _max_sendq;
+      overflowPolicyEnum _overflow_policy;
+      size_t _num_dropped;		// since created
+      bool _overflowed;			// disconnect already asked for
       queue_t _sentq;
+      sentIndex_t _sent_index;		// message id to delivery number
+      uint64_t _sentq_head;		// delivery number of _sentq.front()
+      queue_st _num_sent_holes;		// NULLs left by individual acks
       size_t _prefetch;
+      waiters_t _credit_waiters;
+      headerRules_t _header_rules;
+      headerMatchEnum _header_match;
+      Selector *_selector;
 
       openframe::Stopwatch *_profile;
 
@@ -86,6 +188,7 @@ namespace stomp {
         size_t num_enqueued;
         size_t num_dequeued;
         size_t num_redelivered;
+        size_t num_dropped;
         time_t report_interval;
         time_t last_stats_at;
         time_t created_at;
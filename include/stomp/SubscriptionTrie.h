@@ -0,0 +1,74 @@
+#ifndef LIBSTOMP_SUBSCRIPTIONTRIE_H
+#define LIBSTOMP_SUBSCRIPTIONTRIE_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+namespace stomp {
+
+/**************************************************************************
+ ** General Defines                                                      **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Structures                                                           **
+ **************************************************************************/
+
+  // Indexes subscriptions by their key split on '.'. Literal segments
+  // are trie edges. A key whose next segment holds a glob character is
+  // parked on the node it branches from and globbed only when a lookup
+  // passes through that node, so keys keep their glob semantics while a
+  // lookup costs the depth of the destination plus the wildcard keys
+  // along its path.
+  class Subscription;
+  class SubscriptionTrie {
+    public:
+      typedef std::vector<Subscription *> list_t;
+      typedef list_t::size_type list_st;
+
+      SubscriptionTrie();
+      virtual ~SubscriptionTrie();
+
+      // does not retain, the owner keeps subscriptions alive while indexed
+      bool insert(Subscription *sub);
+      bool remove(Subscription *sub);
+      void clear();
+      list_st match(const std::string &key, list_t &ret) const;
+      inline list_st size() const { return _size; }
+
+      static bool is_wildcard(const char *segment, const size_t len);
+
+    protected:
+    private:
+      struct node_t;
+      typedef std::map<std::string, node_t *> edges_t;
+      typedef edges_t::iterator edges_itr;
+      typedef edges_t::const_iterator edges_citr;
+
+      struct node_t {
+        edges_t edges;
+        list_t exact;		// keys ending at this node
+        list_t wildcard;	// keys with a glob in the next segment
+      };
+
+      SubscriptionTrie(const SubscriptionTrie &);
+      SubscriptionTrie &operator=(const SubscriptionTrie &);
+
+      static void destroy(node_t *node);
+      static bool erase(list_t &list, Subscription *sub);
+
+      node_t *_root;
+      list_st _size;
+  }; // class SubscriptionTrie
+
+/**************************************************************************
+ ** Macro's                                                              **
+ **************************************************************************/
+
+/**************************************************************************
+ ** Proto types                                                          **
+ **************************************************************************/
+
+} // namespace stomp
+#endif
@@ -7,6 +7,8 @@
 #include <openframe/openframe.h>
 #include <openstats/StatsClient_Interface.h>
 
+#include "StompSlice.h"
+
 namespace stomp {
 
 /**************************************************************************
@@ -23,9 +25,11 @@ namespace stomp {
       typedef std::deque<StompFrame *> queue_t;
       typedef queue_t::size_type queue_st;
 
-      Transaction(const std::string &key);
+      Transaction(const StompSlice &key);
       virtual ~Transaction();
 
+      inline const std::string &key() const { return _key; }
+
       void store(StompFrame *frame);
       queue_st dequeue(queue_t &ret);
       void purge_all();
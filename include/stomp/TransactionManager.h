@@ -3,10 +3,13 @@
 
 #include <map>
 #include <string>
+#include <tr1/unordered_map>
 
 #include <openframe/openframe.h>
 #include <openstats/StatsClient_Interface.h>
 
+#include "StompSlice.h"
+
 namespace stomp {
 
 /**************************************************************************
@@ -20,7 +23,8 @@ namespace stomp {
   class Transaction;
   class TransactionManager {
     public:
-      typedef std::map<std::string, Transaction *> transaction_t;
+      // keys point at the key each transaction holds
+      typedef std::tr1::unordered_map<StompSlice, Transaction *, StompSliceHash, StompSliceEqual> transaction_t;
       typedef transaction_t::iterator transaction_itr;
       typedef transaction_t::const_iterator transaction_citr;
       typedef transaction_t::size_type transaction_st;
@@ -28,9 +32,9 @@ namespace stomp {
       TransactionManager();
       virtual ~TransactionManager();
 
-      Transaction *create_transaction(const std::string &key);
-      Transaction *find_transaction(const std::string &key);
-      bool destroy_transaction(const std::string &key);
+      Transaction *create_transaction(const StompSlice &key);
+      Transaction *find_transaction(const StompSlice &key);
+      bool destroy_transaction(const StompSlice &key);
       void destroy_transactions();
 
     protected:
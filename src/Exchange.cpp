@@ -26,24 +26,29 @@ namespace stomp {
   const time_t Exchange::kDefaultExpireInterval		= 5;
   const time_t Exchange::kDefaultRecoverDeadInterval	= 30;
   const size_t Exchange::kDefaultExpireLimit		= 20000;
-  const time_t Exchange::kDefaultDeferredInterval	= 10000;
   const time_t Exchange::kDefaultStatsIntval		= 15;
   const time_t Exchange::kDefaultExchangeStatsInterval	= 10;
   const size_t Exchange::kDefaultByteLimit		= 3145728;
+  const size_t Exchange::kMaxRouteCacheSize		= 1024;
+  const size_t Exchange::kDefaultWeight			= 1;
 
   Exchange::Exchange(const std::string &key)
            : _key(key),
              _expire_interval(kDefaultExpireInterval),
              _expire_limit(kDefaultExpireLimit),
              _last_expire( time(NULL) ),
-             _last_dispatch(0),
              _byte_limit(kDefaultByteLimit),
              _recover_dead_interval(kDefaultRecoverDeadInterval),
-             _last_recover_dead( time(NULL) ) {
+             _last_recover_dead( time(NULL) ),
+             _weight(kDefaultWeight),
+             _deficit(0) {
     _num_posts = 0;
     _num_bytes = 0;
+    _bind_generation = 0;
+    _parked = false;
+    _scheduler = NULL;
+    _num_expired_queued = 0;
     _last_stats = time(NULL);
-    set_deferred_interval(kDefaultDeferredInterval);
     init_stats(kDefaultExchangeStatsInterval, true);
   } // Exchange::Exchange
 
@@ -52,15 +57,12 @@ namespace stomp {
 
     while( !_sendq.empty() ) {
       StompMessage *smesg = _sendq.front();
+      // may outlive us in a subscription, don't leave it filed here
+      smesg->set_expiry_slot(0, 0);
       smesg->release();
       _sendq.pop_front();
     } // while
-
-    while( !_deferd.empty() ) {
-      StompMessage *smesg = _deferd.front();
-      smesg->release();
-      _deferd.pop_front();
-    } // while
+    _expiries.clear();
   } // Exchange::~Exchange
 
   void Exchange::onDescribeStats() {
@@ -136,12 +138,19 @@ namespace stomp {
 
   bool Exchange::bind(Subscription *sub) {
     assert(sub != NULL); // bug
+    if ( !is_bindable(sub) ) return false;
+    // only a queue can hold messages back for a spilling sub, anything
+    // else would stall every other sub sharing it
+    if (sub->overflow_policy() == Subscription::overflowSpill && _type != exchangeTypeFanout) return false;
     bind_citr citr = _binds.find(sub);
     if (citr != _binds.end()) return false;
 
     sub->retain();
     sub->bind();
     _binds.insert(sub);
+    _routes.insert(sub);
+    _bind_generation++;
+    onBind(sub);
     LOG(LogInfo, << "Exchange bound " << sub << " to " << this << std::endl);
     return true;
   } // Exchange::bind
@@ -157,11 +166,39 @@ namespace stomp {
       inc_bytes(smesg);
       LOG(LogDebug, << "Exchange recovering " << smesg << std::endl);
       _sendq.push_front( ml.front() );
+      queued(smesg);
       ++_stats.num_sendq;
       ml.pop_front();
     } // while
+
+    if ( !_sendq.empty() ) runnable();
   } // Exchange::recover_unsent
 
+  time_t Exchange::next_deadline() const {
+    time_t ret = 0;
+
+    if (!_expiries.empty() || is_over_byte_limit()) {
+      time_t when = _last_expire + _expire_interval + 1;
+      if (!_expiries.empty() && _expiries.begin()->first > when) when = _expiries.begin()->first;
+      ret = when;
+    } // if
+
+    // nacked messages are only noticed by polling the binds
+    if (!_binds.empty()) {
+      time_t when = _last_recover_dead + _recover_dead_interval + 1;
+      if (!ret || when < ret) ret = when;
+    } // if
+
+    bool is_stats_pending = _stats.num_posted || _stats.num_dispatched
+                            || _stats.num_deferred || _stats.num_dead;
+    if (is_stats_pending) {
+      time_t when = _stats.last_stats_at + _stats.report_interval;
+      if (!ret || when < ret) ret = when;
+    } // if
+
+    return ret;
+  } // Exchange::next_deadline
+
   mesgList_st Exchange::recover_dead() {
     bool is_ready = is_next_recover_dead();
     if (!is_ready) return 0;
@@ -185,12 +222,14 @@ namespace stomp {
         inc_bytes(smesg);
 //        LOG(LogDebug, << "Exchange recovering dead " << smesg << std::endl);
         _sendq.push_front( ml.front() );
+        queued(smesg);
         ++_stats.num_sendq;
         ml.pop_front();
       } // while
     } // for
 
     _stats.num_dead += num;
+    if (num) runnable();
 
     if (!run_again) _last_recover_dead = time(NULL);
 
@@ -204,7 +243,12 @@ namespace stomp {
     if (itr == _binds.end()) return false;
     LOG(LogInfo, << "Exchange unbound " << sub << " to " << this << std::endl);
     _binds.erase(sub);
+    _routes.remove(sub);
+    _bind_generation++;
+    sub->forget_credit(this);
+    onUnbind(sub);
     recover_unsent(sub);
+    if ( is_parked() ) wake();
     sub->unbind();
     sub->release();
     return true;
@@ -226,12 +270,17 @@ namespace stomp {
     while( !r.empty() ) {
       Subscription *sub = r.front();
       _binds.erase(sub);
+      _routes.remove(sub);
+      _bind_generation++;
+      sub->forget_credit(this);
+      onUnbind(sub);
       LOG(LogInfo, << "Exchange unbound " << sub << " to " << this << std::endl);
       sub->unbind();
       sub->release();
       r.pop();
     } // while
 
+    if ( num && is_parked() ) wake();
     return num;
   } // Exchange::unbind
 
@@ -253,11 +302,16 @@ namespace stomp {
     while( !r.empty() ) {
       Subscription *sub = r.front();
       _binds.erase(sub);
+      _routes.remove(sub);
+      _bind_generation++;
+      sub->forget_credit(this);
+      onUnbind(sub);
       sub->unbind();
       sub->release();
       r.pop();
     } // while
 
+    if ( num && is_parked() ) wake();
     return num;
   } // Exchange::unbind
 
@@ -265,6 +319,8 @@ namespace stomp {
     bind_st num = 0;
     for(bind_itr itr = _binds.begin(); itr != _binds.end(); itr++) {
       Subscription *sub = (*itr);
+      sub->forget_credit(this);
+      onUnbind(sub);
       recover_unsent(sub);
       sub->unbind();
       sub->release();
@@ -272,19 +328,43 @@ namespace stomp {
     } // for
 
     _binds.clear();
+    _routes.clear();
+    _bind_generation++;
     return num;
   } // Exchange::unbind_all
 
-  Exchange::list_st Exchange::find_matches(const string &key, list_t &ret) {
-    for(bind_itr itr = _binds.begin(); itr != _binds.end(); itr++) {
-      Subscription *sub = (*itr);
-      if (!sub->match(key) || !sub->prefetch_ok() ) continue;
-      ret.push_back(sub);
+  // the routed subscriptions that can take smesg now and want it
+  Exchange::list_st Exchange::find_matches(StompMessage *smesg, list_t &ret) {
+    const list_t &subs = routes( smesg->destination() );
+    for(list_st i=0; i < subs.size(); i++) {
+      if ( subs[i]->prefetch_ok() && subs[i]->selects(smesg) ) ret.push_back(subs[i]);
     } // for
 
-    return ret.size();;
+    return ret.size();
   } // Exchange::find_matches
 
+  // prefetch is not part of the cached routes, callers check it live
+  const Exchange::list_t &Exchange::routes(const string &key) {
+    routes_itr itr = _route_cache.find(key);
+    if (itr == _route_cache.end()) {
+      if (_route_cache.size() >= kMaxRouteCacheSize) _route_cache.clear();
+      route_t route;
+      route.cached = false;
+      route.generation = 0;
+      itr = _route_cache.insert( make_pair(key, route) ).first;
+    } // if
+
+    route_t &route = itr->second;
+    if (!route.cached || route.generation != _bind_generation) {
+      route.subs.clear();
+      _routes.match(key, route.subs);
+      route.generation = _bind_generation;
+      route.cached = true;
+    } // if
+
+    return route.subs;
+  } // Exchange::routes
+
   const string Exchange::toString() const {
     std::stringstream out;
     out << "Exchange "
@@ -307,24 +387,43 @@ namespace stomp {
       last_report = time(NULL);
     } // if
 
-    bool is_ready =  is_next_expire() && !_sendq.empty();
+    time_t now = time(NULL);
+    bool is_due = !_expiries.empty() && _expiries.begin()->first <= now;
+    bool is_ready =  is_next_expire() && (is_due || is_over_byte_limit());
     if (!is_ready) return 0;
 
     openframe::Stopwatch sw;
     sw.Start();
 
+    // only buckets that are due are visited, everything in them is
+    // still queued since messages leaving _sendq are unfiled
     size_t num_checked = 0;
-    while( !_sendq.empty() && num_checked < _expire_limit) {
-      StompMessage *smesg = _sendq.front();
-      ++num_checked;
+    while( !_expiries.empty() && _expiries.begin()->first <= now && num_checked < _expire_limit) {
+      expiries_itr itr = _expiries.begin();
+      expiryBucket_t &bucket = itr->second;
+      for(expiryBucket_t::size_type i=0; i < bucket.size(); i++) {
+        StompMessage *smesg = bucket[i];
+        ++num_checked;
+        // stays in _sendq until it reaches the head, see next_message()
+        smesg->set_expiry_slot(0, 0);
+        smesg->mark_expired();
+        dec_bytes(smesg);
+        ++_num_expired_queued;
+        ++num_expired;
+      } // for
+      _expiries.erase(itr);
+    } // while
 
-      bool is_inactive = smesg->is_inactive() || is_over_byte_limit();
-      if (!is_inactive) break;
+    // a parked queue may not reach its head for a while, don't let
+    // expired messages pin their memory until then
+    if (_num_expired_queued * 2 > _sendq.size()) compact_expired();
 
-      if (!smesg->is_inactive()) num_over_limit++;
+    // over the byte limit the oldest messages go first
+    StompMessage *smesg;
+    while( is_over_byte_limit() && next_message(smesg) ) {
       expire(smesg);
+      ++num_over_limit;
       ++num_expired;
-      _sendq.pop_front();
     } // while
 
     int end_time = int(sw.Time() * 1000);
@@ -338,14 +437,14 @@ namespace stomp {
 
     if (num_expired)
       LOG(LogWarn, << "Exchange expired "
-                   << num_expired << " inactive "
+                   << (num_expired - num_over_limit) << " inactive "
                    << num_over_limit << " over byte limit ("
                    << _byte_limit << ") messages in "
                    << end_time << "ms from "
                    << this << std::endl);
 
     // prevent long expire times
-    if (num_checked == _expire_limit)
+    if (num_checked >= _expire_limit)
       // we want to run again to continue expiring but sooner
       // since we expired our max last time
       _last_expire += 2;
@@ -366,6 +465,7 @@ namespace stomp {
     // up logging later.
     smesg->retain();
     _sendq.push_back(smesg);
+    queued(smesg);
 
     datapoint("num.posts", 1);
 
@@ -373,8 +473,87 @@ namespace stomp {
     _stats.num_posted++;
     _stats.num_sendq++;
     inc_bytes(smesg);
+    runnable();
   } // Exchange::post
 
+  // files a message that just entered _sendq under its deadline
+  void Exchange::queued(StompMessage *smesg) {
+    // anything leaving a _sendq was unfiled on the way out
+    assert(!smesg->expiry_at());	// bug
+    smesg->mark_unexpired();
+
+    time_t expires_at = smesg->expires_at();
+    if (!expires_at) return;
+
+    expiryBucket_t &bucket = _expiries[expires_at];
+    smesg->set_expiry_slot(expires_at, bucket.size());
+    bucket.push_back(smesg);
+  } // Exchange::queued
+
+  // swaps the last entry of the bucket into the slot smesg leaves
+  void Exchange::unfile_expiry(StompMessage *smesg) {
+    time_t at = smesg->expiry_at();
+    if (!at) return;
+
+    expiries_itr itr = _expiries.find(at);
+    assert(itr != _expiries.end());	// bug
+    expiryBucket_t &bucket = itr->second;
+    size_t slot = smesg->expiry_slot();
+    assert(slot < bucket.size() && bucket[slot] == smesg);	// bug
+
+    bucket[slot] = bucket.back();
+    bucket[slot]->set_expiry_slot(at, slot);
+    bucket.pop_back();
+    if ( bucket.empty() ) _expiries.erase(itr);
+    smesg->set_expiry_slot(0, 0);
+  } // Exchange::unfile_expiry
+
+  // pops the next live message, expired ones left in the queue by
+  // expire_inactive() are already accounted for and only released here
+  bool Exchange::next_message(StompMessage *&smesg) {
+    while( !_sendq.empty() ) {
+      smesg = _sendq.front();
+      _sendq.pop_front();
+      if ( smesg->is_expired() ) {
+        _num_expired_queued--;
+        smesg->release();
+        continue;
+      } // if
+
+      unfile_expiry(smesg);
+      return true;
+    } // while
+
+    return false;
+  } // Exchange::next_message
+
+  // the next live message stays at the head, expired ones are dropped
+  bool Exchange::peek_message(StompMessage *&smesg) {
+    while( !_sendq.empty() ) {
+      smesg = _sendq.front();
+      if ( !smesg->is_expired() ) return true;
+      _sendq.pop_front();
+      _num_expired_queued--;
+      smesg->release();
+    } // while
+
+    return false;
+  } // Exchange::peek_message
+
+  void Exchange::compact_expired() {
+    queue_t sendq;
+    for(queue_t::iterator itr = _sendq.begin(); itr != _sendq.end(); itr++) {
+      StompMessage *smesg = *itr;
+      if ( smesg->is_expired() )
+        smesg->release();
+      else
+        sendq.push_back(smesg);
+    } // for
+
+    _sendq.swap(sendq);
+    _num_expired_queued = 0;
+  } // Exchange::compact_expired
+
   size_t Exchange::inc_bytes(StompMessage *smesg) {
     _num_bytes += smesg->body().length();
     return _num_bytes;
@@ -386,6 +565,19 @@ namespace stomp {
     return _num_bytes;
   } // Exchange::dec_bytes
 
+  void Exchange::park() {
+    _parked = true;
+  } // Exchange::park
+
+  void Exchange::wake() {
+    _parked = false;
+    if ( !_sendq.empty() ) runnable();
+  } // Exchange::wake
+
+  void Exchange::runnable() {
+    if (_scheduler != NULL) _scheduler->onRunnable(this);
+  } // Exchange::runnable
+
   void Exchange::expire(StompMessage *smesg) {
     dispatched(smesg);
   } // Exchange::expire
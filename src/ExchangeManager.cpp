@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include <string>
+#include <algorithm>
 #include <cassert>
 #include <list>
 #include <map>
@@ -11,7 +12,9 @@
 #include <openframe/openframe.h>
 
 #include "Exchange.h"
+#include "Exchange_Direct.h"
 #include "Exchange_Fanout.h"
+#include "Exchange_Headers.h"
 #include "Exchange_Topic.h"
 #include "ExchangeManager.h"
 #include "Subscription.h"
@@ -23,9 +26,11 @@ namespace stomp {
 /**************************************************************************
  ** Exchange Class                                                       **
  **************************************************************************/
-  const size_t ExchangeManager::kDispatchLimit	= 100;
+  const size_t ExchangeManager::kDispatchLimit		= 100;	// per unit of weight
+  const double ExchangeManager::kDefaultDispatchBudget	= 0.050;
 
-  ExchangeManager::ExchangeManager() {
+  ExchangeManager::ExchangeManager()
+                  : _dispatch_budget(kDefaultDispatchBudget) {
 
   } // ExchangeManager::ExchangeManager
 
@@ -43,6 +48,11 @@ namespace stomp {
 
   Exchange *ExchangeManager::create_exchange(const std::string &key, const Exchange::exchangeTypeEnum exchange_type) {
     assert( key.length() ); 	// bug
+    if (exchange_type == Exchange::exchangeTypeDirect) {
+      direct_itr ditr = _direct.find(key);
+      if (ditr != _direct.end()) return ditr->second;
+    } // if
+
     exchange_itr itr = _exchanges.find(key);
     if (itr != _exchanges.end()) {
 //      log(LogInfo) << "ExchangeManager found existing key; " << key << std::endl;
@@ -59,7 +69,11 @@ namespace stomp {
           exch = new Exchange_Topic(key);
           break;
         case Exchange::exchangeTypeDirect:
+          exch = new Exchange_Direct(key);
+          break;
         case Exchange::exchangeTypeHeaders:
+          exch = new Exchange_Headers(key);
+          break;
         default:
           assert(false);	// bug
       } // switch
@@ -74,7 +88,11 @@ namespace stomp {
 
     LOG(LogInfo, << "ExchangeManager created " << exch << std::endl);
     _exchanges.insert( make_pair(key, exch) );
-    match_subscriptions();
+    if (exchange_type == Exchange::exchangeTypeDirect) _direct[key] = exch;
+    exch->set_scheduler(this);
+    weights_citr witr = _weights.find(key);
+    if (witr != _weights.end()) exch->set_weight(witr->second);
+    bind_subscriptions(exch);
     return exch;
   } // ExchangeManager::create_exchange
 
@@ -85,6 +103,10 @@ namespace stomp {
     Exchange *exch = itr->second;
     LOG(LogInfo, << "ExchangeManager destroyed " << exch << std::endl);
     _exchanges.erase( key );
+    _direct.erase( key );
+    for(bindings_itr bitr = _bindings.begin(); bitr != _bindings.end(); bitr++)
+      bitr->second.erase(exch);
+    unschedule(exch);
     exch->release();
     return true;
   } // ExchangeManager::destroy_exchange
@@ -94,31 +116,144 @@ namespace stomp {
       std::string key = itr->first;
       Exchange *exch = itr->second;
       LOG(LogInfo, << "ExchangeManager destroyed " << exch << std::endl);
+      exch->set_scheduler(NULL);
       exch->release();
     } // for
     _exchanges.clear();
+    _direct.clear();
+    _bindings.clear();
+    _runq.clear();
+    _runnable.clear();
+    _timers.clear();
+    _timer_at.clear();
   } // ExchangeManager::destroy_exchanges
 
+  ExchangeManager &ExchangeManager::set_weight(const std::string &key, const size_t weight) {
+    _weights[key] = weight;
+    exchange_itr itr = _exchanges.find(key);
+    if (itr != _exchanges.end()) itr->second->set_weight(weight);
+    return *this;
+  } // ExchangeManager::set_weight
+
+  // only exchanges with queued work or a deadline that came due are
+  // visited, the rest cost nothing no matter how many there are
+  //
+  // runnable exchanges take turns deficit round robin style, each turn
+  // adds kDispatchLimit times the weight to what the exchange may send
+  // and whatever it could not use carries over while it stays runnable.
+  // once the time budget is spent the exchanges that missed their turn
+  // keep their place at the head of the queue for the next pass.
   void ExchangeManager::dispatch_exchanges() {
-    for(exchange_itr itr = _exchanges.begin(); itr != _exchanges.end(); itr++) {
+    openframe::Stopwatch sw;
+    sw.Start();
+
+    time_t now = time(NULL);
+    while( !_timers.empty() && _timers.begin()->first <= now ) {
+      timers_itr itr = _timers.begin();
       Exchange *exch = itr->second;
-      size_t num_dispatched = exch->dispatch(kDispatchLimit);
+      time_t when = itr->first;
+      _timers.erase(itr);
+
+      timerAt_itr titr = _timer_at.find(exch);
+      if (titr == _timer_at.end() || titr->second != when) continue;
+      _timer_at.erase(titr);
+      onRunnable(exch);
+    } // while
+
+    // exchanges made runnable while this pass runs wait for the next one,
+    // the head of the queue always gets its turn so a pass can't stall
+    bool is_first = true;
+    for(runq_st num = _runq.size(); num && !_runq.empty(); num--) {
+      if (!is_first && _dispatch_budget > 0 && sw.Time() > _dispatch_budget) break;
+
+      Exchange *exch = _runq.front();
+      _runq.pop_front();
+      // gone if it was destroyed since it was queued
+      if ( !_runnable.erase(exch) ) continue;
+      is_first = false;
+
+      size_t quantum = kDispatchLimit * exch->weight();
+      size_t share = exch->deficit() + quantum;
+      size_t num_dispatched = exch->dispatch(share);
       exch->try_stats();
+
+      if ( exch->is_runnable() ) {
+        // never carry more than one turn, a stalled exchange can't save up
+        size_t deficit = (num_dispatched < share ? share - num_dispatched : 0);
+        exch->set_deficit( std::min(deficit, quantum) );
+        onRunnable(exch);
+      } // if
+      else
+        exch->set_deficit(0);
+
+      schedule(exch);
     } // for
   } // ExchangeManager::dispatch_exchanges
 
-  void ExchangeManager::match_subscriptions() {
-    for(subscriptions_itr itr = _subscriptions.begin(); itr != _subscriptions.end(); itr++) {
-      Subscription *sub = *itr;
-      subscribe(sub);
+  void ExchangeManager::onRunnable(Exchange *exch) {
+    if ( !_runnable.insert(exch).second ) return;
+    _runq.push_back(exch);
+  } // ExchangeManager::onRunnable
+
+  // arms the timer for the next deadline unless an earlier one is set
+  void ExchangeManager::schedule(Exchange *exch) {
+    time_t when = exch->next_deadline();
+    if (!when) return;
+
+    timerAt_itr itr = _timer_at.find(exch);
+    if (itr != _timer_at.end() && itr->second <= when) return;
+
+    _timer_at[exch] = when;
+    _timers.insert( std::make_pair(when, exch) );
+  } // ExchangeManager::schedule
+
+  // entries left in _runq and _timers are skipped once these are gone
+  void ExchangeManager::unschedule(Exchange *exch) {
+    exch->set_scheduler(NULL);
+    _runnable.erase(exch);
+    _timer_at.erase(exch);
+  } // ExchangeManager::unschedule
+
+  // binds the stored subscriptions whose key matches a new exchange
+  ExchangeManager::subscriptions_st ExchangeManager::bind_subscriptions(Exchange *exch) {
+    SubscriptionTrie::list_t subs;
+    _index.match(exch->key(), subs);
+
+    subscriptions_st num = 0;
+    for(SubscriptionTrie::list_st i=0; i < subs.size(); i++) {
+      if ( bind(exch, subs[i]) ) num++;
     } // for
-  } // ExchangeManager::match_subscriptions
+    return num;
+  } // ExchangeManager::bind_subscriptions
+
+  bool ExchangeManager::bind(Exchange *exch, Subscription *sub) {
+    bool ok = exch->bind(sub);
+    if (ok) _bindings[sub].insert(exch);
+    return ok;
+  } // ExchangeManager::bind
+
+  ExchangeManager::exchange_st ExchangeManager::unbind(Subscription *sub) {
+    bindings_itr itr = _bindings.find(sub);
+    if (itr == _bindings.end()) return 0;
+
+    exchange_st num = 0;
+    // take the set first, unbinding may release the last reference
+    std::set<Exchange *> exchanges;
+    exchanges.swap(itr->second);
+    _bindings.erase(itr);
+
+    for(std::set<Exchange *>::iterator eitr = exchanges.begin(); eitr != exchanges.end(); eitr++) {
+      if ( (*eitr)->unbind(sub) ) num++;
+    } // for
+    return num;
+  } // ExchangeManager::unbind
 
   bool ExchangeManager::store_subscription(Subscription *sub) {
     subscriptions_citr citr = _subscriptions.find(sub);
     if (citr != _subscriptions.end()) return false;
     sub->retain();
     _subscriptions.insert(sub);
+    _index.insert(sub);
     LOG(LogInfo, << "ExchangeManager stored " << sub << std::endl);
     return true;
   } // EchangeManager::store_subscription
@@ -127,6 +262,7 @@ namespace stomp {
     subscriptions_citr citr = _subscriptions.find(sub);
     if (citr == _subscriptions.end()) return false;
     _subscriptions.erase(sub);
+    _index.remove(sub);
     LOG(LogInfo, << "ExchangeManager forgot " << sub << std::endl);
     sub->release();
     return true;
@@ -139,6 +275,7 @@ namespace stomp {
       sub->release();
     } // for
     _subscriptions.clear();
+    _index.clear();
   } // ExchangeManager::forget_subscriptions
 
   void ExchangeManager::forget_subscriptions(StompPeer *peer) {
@@ -152,6 +289,7 @@ namespace stomp {
     while( !rlist.empty() ) {
       Subscription *sub = rlist.front();
       _subscriptions.erase(sub);
+      _index.remove(sub);
       LOG(LogInfo, << "ExchangeManager forgot " << sub << std::endl);
       sub->release();
       rlist.pop_front();
@@ -160,20 +298,34 @@ namespace stomp {
 
   ExchangeManager::exchange_st ExchangeManager::subscribe(Subscription *sub) {
     exchange_st num = 0;
-    for(exchange_itr itr = _exchanges.begin(); itr != _exchanges.end(); itr++) {
-      Exchange *exch = itr->second;
-//      log(LogInfo) << "ExchangeManager checking " << sub << " against " << exch << std::endl;
-      bool ok = sub->match(itr->first);
-      if (!ok) continue;
-      exch->bind(sub);
-      // if (bound) log(LogInfo) << "ExchangeManager binding " << sub << " to " << exch << std::endl;
-      num++;
-    } // for
+    const std::string &key = sub->key();
+
+    // only exchanges sharing the literal prefix of the key can match, and
+    // without a glob the key names at most one exchange
+    std::string::size_type glob = key.find_first_of("*?");
+    if (glob == std::string::npos) {
+      exchange_itr itr = _exchanges.find(key);
+      if (itr != _exchanges.end()) {
+        bind(itr->second, sub);
+        num++;
+      } // if
+    } // if
+    else {
+      std::string prefix = key.substr(0, glob);
+      for(exchange_itr itr = _exchanges.lower_bound(prefix);
+          itr != _exchanges.end() && itr->first.compare(0, prefix.length(), prefix) == 0; itr++) {
+        bool ok = sub->match(itr->first);
+        if (!ok) continue;
+        bind(itr->second, sub);
+        num++;
+      } // for
+    } // else
+
     store_subscription(sub);
-    return num++;
+    return num;
   } // ExchangeManager::subscribe
 
-  Subscription *ExchangeManager::find_subscription(StompPeer *peer, const std::string &id) {
+  Subscription *ExchangeManager::find_subscription(StompPeer *peer, const StompSlice &id) {
     for(subscriptions_itr itr = _subscriptions.begin(); itr != _subscriptions.end(); itr++) {
       Subscription *sub = *itr;
       if ( sub->is_id(id) && sub->is_peer(peer) ) return sub;
@@ -193,23 +345,20 @@ namespace stomp {
   } // ExchangeManager::unsubscribe
 */
   ExchangeManager::exchange_st ExchangeManager::unsubscribe(Subscription *sub) {
-    exchange_st num = 0;
-    for(exchange_itr itr = _exchanges.begin(); itr != _exchanges.end(); itr++) {
-      Exchange *exch = itr->second;
-      num += exch->unbind(sub);
-    } // for
+    exchange_st num = unbind(sub);
     forget_subscription(sub);
-    return num++;
+    return num;
   } // ExchangeManager::unsubscribe
 
   ExchangeManager::exchange_st ExchangeManager::unsubscribe(StompPeer *peer) {
     exchange_st num = 0;
-    for(exchange_itr itr = _exchanges.begin(); itr != _exchanges.end(); itr++) {
-      Exchange *exch = itr->second;
-      num += exch->unbind(peer);
+    for(subscriptions_itr itr = _subscriptions.begin(); itr != _subscriptions.end(); itr++) {
+      Subscription *sub = *itr;
+      if (!sub->is_peer(peer)) continue;
+      num += unbind(sub);
     } // for
     forget_subscriptions(peer);
-    return num++;
+    return num;
   } // ExchangeManager::unsubscribe
 
 //  std::ostream &operator<<(std::ostream &ss, const Exchange *exch) {
@@ -0,0 +1,88 @@
+#include "config.h"
+
+#include <string>
+#include <cassert>
+#include <list>
+#include <map>
+#include <new>
+#include <iostream>
+#include <sstream>
+
+#include <openframe/openframe.h>
+
+#include "StompMessage.h"
+#include "Exchange_Direct.h"
+#include "Subscription.h"
+
+namespace stomp {
+  using namespace openframe::loglevel;
+
+/**************************************************************************
+ ** Exchange Class                                                       **
+ **************************************************************************/
+  Exchange_Direct::Exchange_Direct(const std::string &key) :
+    Exchange(key) {
+    _type = exchangeTypeDirect;
+  } // Exchange_Direct::Exchange_Direct
+
+  Exchange_Direct::~Exchange_Direct() {
+  } // Exchange_Direct::~Exchange_Direct
+
+  const string Exchange_Direct::toString() const {
+    std::stringstream out;
+    out << "Exchange_Direct "
+        << "key=" << key()
+        << ",binds=" << _binds.size()
+        << ",sendq=" << _sendq.size()
+        << ",unackd=" << _unackd.size();
+    return out.str();
+  } // Exchange_Direct::toString
+
+  bool Exchange_Direct::is_bindable(Subscription *sub) const {
+    return sub->key() == key();
+  } // Exchange_Direct::is_bindable
+
+  size_t Exchange_Direct::onDispatch(const size_t limit) {
+    size_t num;
+    size_t num_deferred = 0;
+    size_t num_dispatched = 0;
+
+    bool is_work_pending = !_sendq.empty();
+    if (!is_work_pending) return 0;
+
+    StompMessage *smesg;
+    for(num=0; num < limit && next_message(smesg); num++) {
+
+      // pass smesg off to every bind and release our interest for now
+      size_t num_enqueued = 0;
+      for(bind_itr itr = _binds.begin(); itr != _binds.end(); itr++) {
+        Subscription *sub = *itr;
+        if (!sub->prefetch_ok() || !sub->selects(smesg)) continue;
+        smesg->requires_resp(false);
+        sub->enqueue(smesg);
+        num_enqueued++;
+        LOG(LogDebug, << "Exchange_Direct delivering message; " << smesg
+                      << " to " << sub << std::endl);
+      } // for
+
+      if (!num_enqueued) {
+        // nobody to take it so we drop this packet
+        dispatched(smesg);
+        num_deferred++;
+        continue;
+      } // if
+
+      num_dispatched++;
+      dispatched(smesg);
+    } // for
+
+    _stats.num_dispatched += num_dispatched;
+    _stats.num_deferred += num_deferred;
+    _stats.num_sendq -= num;
+
+    datapoint("num.dispatched", num);
+    datapoint("num.deferred", num_deferred);
+
+    return num;
+  } // Exchange_Direct::onDispatch
+} // namespace stomp
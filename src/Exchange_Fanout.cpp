@@ -7,6 +7,7 @@
 #include <new>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 #include <openframe/openframe.h>
 
@@ -21,13 +22,61 @@ namespace stomp {
  ** Exchange Class                                                       **
  **************************************************************************/
   Exchange_Fanout::Exchange_Fanout(const std::string &key) :
-    Exchange(key), _index(0) {
+    Exchange(key) {
     _type = exchangeTypeFanout;
   } // Exchange_Fanout::Exchange_Fanout
 
   Exchange_Fanout::~Exchange_Fanout() {
+    // unbind while our onUnbind is still reachable
+    unbind_all();
   } // Exchange_Fanout::~Exchange_Fanout
 
+  void Exchange_Fanout::onBind(Subscription *sub) {
+    _ready.push_back(sub);
+    wake();
+  } // Exchange_Fanout::onBind
+
+  void Exchange_Fanout::onUnbind(Subscription *sub) {
+    for(ring_itr itr = _ready.begin(); itr != _ready.end(); itr++) {
+      if (*itr != sub) continue;
+      _ready.erase(itr);
+      break;
+    } // for
+  } // Exchange_Fanout::onUnbind
+
+  void Exchange_Fanout::onCredit(Subscription *sub) {
+    _ready.push_back(sub);
+    wake();
+  } // Exchange_Fanout::onCredit
+
+  // rotates the ring once at most looking for a sub whose selector takes
+  // smesg, subs found out of prefetch room, or of sendq room while
+  // spilling, are parked until they drain and hand themselves back
+  // through onCredit()
+  Subscription *Exchange_Fanout::next_ready(StompMessage *smesg) {
+    for(ring_st n = _ready.size(); n > 0 && !_ready.empty(); n--) {
+      Subscription *sub = _ready.front();
+      _ready.pop_front();
+      if ( !sub->prefetch_ok() || sub->is_spilling() ) {
+        sub->wait_for_credit(this);
+        continue;
+      } // if
+      _ready.push_back(sub);
+      if ( sub->selects(smesg) ) return sub;
+    } // for
+
+    return NULL;
+  } // Exchange_Fanout::next_ready
+
+  // kept for whoever binds next unless every bind turns it down
+  bool Exchange_Fanout::is_wanted(StompMessage *smesg) const {
+    if ( _binds.empty() ) return true;
+    for(bind_citr citr = _binds.begin(); citr != _binds.end(); citr++) {
+      if ( (*citr)->selects(smesg) ) return true;
+    } // for
+    return false;
+  } // Exchange_Fanout::is_wanted
+
   const string Exchange_Fanout::toString() const {
     std::stringstream out;
     time_t diff = time(NULL) - _last_stats;
@@ -37,6 +86,7 @@ namespace stomp {
         << "key=" << key()
         << ",posts=" << std::fixed << std::setprecision(2) << posts_ps << "/s"
         << ",binds=" << _binds.size()
+        << ",ready=" << _ready.size()
         << ",sendq=" << _sendq.size()
         << ",unackd=" << _unackd.size()
         << ",bytes=" << _num_bytes;
@@ -47,48 +97,48 @@ namespace stomp {
     size_t num;
     size_t num_dispatched = 0;
     size_t num_deferred = 0;
+    size_t num_dropped = 0;
 
     if (_last_stats < time(NULL) - kDefaultStatsIntval) {
       _last_stats = time(NULL);
       _num_posts = 0;
     } // if
 
-    bool is_work_pending = !_binds.empty() && !_sendq.empty() && is_next_dispatch();
+    bool is_work_pending = !is_parked() && !_sendq.empty();
     if (!is_work_pending) return 0;
 
-    for(num=0; num < limit && !_sendq.empty(); num++) {
-      StompMessage *smesg = _sendq.front();
-      _sendq.pop_front();
+    for(num=0; num < limit; num++) {
+      StompMessage *smesg;
+      if ( !peek_message(smesg) ) break;
 
-      list_t subs;
-      bool found = find_matches(smesg->destination(), subs);
-      if (!found) {
-//        log(LogDebug) << "Exchange_Fanout deferred message; " << smesg << std::endl;
-        _deferd.push_front(smesg);
-        num_deferred++;
+      Subscription *sub = next_ready(smesg);
+      if (sub == NULL && !is_wanted(smesg) ) {
+        // every selector turns it down, nobody will ever take it
+        next_message(smesg);
+        dispatched(smesg);
+        num_dropped++;
         continue;
       } // if
 
+      if (sub == NULL) {
+        // nobody bound or every consumer that wants it is out of prefetch
+        // room, the rest stays behind it until onBind or onCredit
+        num_deferred = std::min(limit - num, _sendq.size());
+        park();
+        break;
+      } // if
+
+      next_message(smesg);
+
       // pass smesg off to Subcription and release our interest for now
-      unsigned int index = (_index++ % subs.size());
-      subs[index]->enqueue(smesg);
+      sub->enqueue(smesg);
 //      log(LogDebug) << "Exchange_Fanout delivering message; " << smesg
-//                    << " to index " << (index+1) << "; " << subs[index] << std::endl;
+//                    << " to " << sub << std::endl;
       num_dispatched++;
       dispatched(smesg);
     } // for
 
-    if ( !_deferd.empty() ) {
-      set_delayed_dispatch();
-      // push deferd back onto the front of the queue
-      while( !_deferd.empty() ) {
-        StompMessage *smesg = _deferd.front();
-        _sendq.push_front(smesg);
-        _deferd.pop_front();
-      } // while
-    } // if
-
-    _stats.num_sendq -= num_dispatched;
+    _stats.num_sendq -= num_dispatched + num_dropped;
     _stats.num_dispatched += num_dispatched;
     _stats.num_deferred += num_deferred;
 
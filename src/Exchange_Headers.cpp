@@ -0,0 +1,188 @@
+#include "config.h"
+
+#include <string>
+#include <cassert>
+#include <cctype>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <new>
+#include <iostream>
+#include <sstream>
+
+#include <openframe/openframe.h>
+
+#include "StompMessage.h"
+#include "Exchange_Headers.h"
+#include "Subscription.h"
+
+namespace stomp {
+  using namespace openframe::loglevel;
+
+/**************************************************************************
+ ** Exchange Class                                                       **
+ **************************************************************************/
+  Exchange_Headers::Exchange_Headers(const std::string &key) :
+    Exchange(key), _message(0) {
+    _type = exchangeTypeHeaders;
+  } // Exchange_Headers::Exchange_Headers
+
+  Exchange_Headers::~Exchange_Headers() {
+    // the index has to be around while the binds are undone
+    unbind_all();
+  } // Exchange_Headers::~Exchange_Headers
+
+  const string Exchange_Headers::toString() const {
+    std::stringstream out;
+    out << "Exchange_Headers "
+        << "key=" << key()
+        << ",binds=" << _binds.size()
+        << ",index=" << _index.size()
+        << ",sendq=" << _sendq.size()
+        << ",unackd=" << _unackd.size();
+    return out.str();
+  } // Exchange_Headers::toString
+
+  void Exchange_Headers::onBind(Subscription *sub) {
+    slots_st slot;
+    if (_free.empty()) {
+      slot = _slots.size();
+      _slots.push_back( slot_t() );
+    } // if
+    else {
+      slot = _free.back();
+      _free.pop_back();
+    } // else
+
+    const Subscription::headerRules_t &rules = sub->header_rules();
+    slot_t &s = _slots[slot];
+    s.sub = sub;
+    s.required = (sub->header_match() == Subscription::headerMatchAny ? 1 : rules.size());
+    s.hits = 0;
+    s.message = 0;
+    _slot_of[sub] = slot;
+
+    if (rules.empty()) {
+      _unconditional.push_back(slot);
+      return;
+    } // if
+
+    for(Subscription::headerRules_citr itr = rules.begin(); itr != rules.end(); itr++) {
+      index_itr iitr = _index.find(itr->first);
+      if (iitr == _index.end()) {
+        name_t name;
+        name.message = 0;
+        iitr = _index.insert( make_pair(itr->first, name) ).first;
+      } // if
+      iitr->second.values[itr->second].push_back(slot);
+    } // for
+  } // Exchange_Headers::onBind
+
+  void Exchange_Headers::onUnbind(Subscription *sub) {
+    std::map<Subscription *, slots_st>::iterator sitr = _slot_of.find(sub);
+    if (sitr == _slot_of.end()) return;
+    slots_st slot = sitr->second;
+    _slot_of.erase(sitr);
+
+    const Subscription::headerRules_t &rules = sub->header_rules();
+    if (rules.empty())
+      _unconditional.erase( std::remove(_unconditional.begin(), _unconditional.end(), slot), _unconditional.end() );
+
+    for(Subscription::headerRules_citr itr = rules.begin(); itr != rules.end(); itr++) {
+      index_itr iitr = _index.find(itr->first);
+      if (iitr == _index.end()) continue;
+      values_itr vitr = iitr->second.values.find(itr->second);
+      if (vitr == iitr->second.values.end()) continue;
+
+      slotList_t &slots = vitr->second;
+      slots.erase( std::remove(slots.begin(), slots.end(), slot), slots.end() );
+      if (slots.empty()) iitr->second.values.erase(vitr);
+      if (iitr->second.values.empty()) _index.erase(iitr);
+    } // for
+
+    _slots[slot].sub = NULL;
+    _free.push_back(slot);
+  } // Exchange_Headers::onUnbind
+
+  // binds whose rules the headers of smesg satisfy, valid until the next
+  // call, a header repeated in the message only counts the first time
+  const Exchange_Headers::list_t &Exchange_Headers::match(StompMessage *smesg) {
+    ++_message;
+    _matched.clear();
+
+    for(slotList_t::size_type i=0; i < _unconditional.size(); i++)
+      _matched.push_back( _slots[ _unconditional[i] ].sub );
+
+    for(size_t i=0; i < smesg->num_headers() && !_index.empty(); i++) {
+      // rule names are lowercase, see Subscription::add_header_rule
+      StompSlice name = smesg->header_name(i);
+      _scratch.resize( name.length() );
+      for(size_t j=0; j < name.length(); j++) _scratch[j] = tolower( (unsigned char) name.data()[j] );
+      index_itr iitr = _index.find(_scratch);
+      if (iitr == _index.end()) continue;
+      if (iitr->second.message == _message) continue;
+      iitr->second.message = _message;
+
+      StompSlice value = smesg->header_value(i);
+      _scratch.assign(value.data(), value.length());
+      values_itr vitr = iitr->second.values.find(_scratch);
+      if (vitr == iitr->second.values.end()) continue;
+
+      slotList_t &slots = vitr->second;
+      for(slotList_t::size_type j=0; j < slots.size(); j++) {
+        slot_t &s = _slots[ slots[j] ];
+        if (s.message != _message) {
+          s.message = _message;
+          s.hits = 0;
+        } // if
+        if (++s.hits == s.required) _matched.push_back(s.sub);
+      } // for
+    } // for
+
+    return _matched;
+  } // Exchange_Headers::match
+
+  size_t Exchange_Headers::onDispatch(const size_t limit) {
+    size_t num;
+    size_t num_deferred = 0;
+    size_t num_dispatched = 0;
+
+    bool is_work_pending = !_sendq.empty();
+    if (!is_work_pending) return 0;
+
+    StompMessage *smesg;
+    for(num=0; num < limit && next_message(smesg); num++) {
+
+      // pass smesg off to Subcription and release our interest for now
+      const list_t &subs = match(smesg);
+      size_t num_enqueued = 0;
+      for(list_st i=0; i < subs.size(); i++) {
+        if (!subs[i]->prefetch_ok() || !subs[i]->selects(smesg)) continue;
+        smesg->requires_resp(false);
+        subs[i]->enqueue(smesg);
+        num_enqueued++;
+        LOG(LogDebug, << "Exchange_Headers delivering message; " << smesg
+                      << " to subscription " << (i+1) << "; " << subs[i] << std::endl);
+      } // for
+
+      if (!num_enqueued) {
+        // no matching subs so we drop this packet
+        dispatched(smesg);
+        num_deferred++;
+        continue;
+      } // if
+
+      num_dispatched++;
+      dispatched(smesg);
+    } // for
+
+    _stats.num_dispatched += num_dispatched;
+    _stats.num_deferred += num_deferred;
+    _stats.num_sendq -= num;
+
+    datapoint("num.dispatched", num);
+    datapoint("num.deferred", num_deferred);
+
+    return num;
+  } // Exchange_Headers::onDispatch
+} // namespace stomp
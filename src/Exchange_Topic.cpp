@@ -46,26 +46,28 @@ namespace stomp {
     bool is_work_pending = !_sendq.empty();
     if (!is_work_pending) return 0;
 
-    for(num=0; num < limit && _sendq.size(); num++) {
-      StompMessage *smesg = _sendq.front();
-      _sendq.pop_front();
-
-      list_t subs;
-      bool found = find_matches(smesg->destination(), subs);
-      if (!found) {
-        // no matching subs so we drop this packet
-        dispatched(smesg);
-        num_deferred++;
-        continue;
-      } // if
+    StompMessage *smesg;
+    for(num=0; num < limit && next_message(smesg); num++) {
 
       // pass smesg off to Subcription and release our interest for now
+      const list_t &subs = routes( smesg->destination() );
+      size_t num_enqueued = 0;
       for(list_st i=0; i < subs.size(); i++) {
+        if (!subs[i]->prefetch_ok() || !subs[i]->selects(smesg)) continue;
         smesg->requires_resp(false);
         subs[i]->enqueue(smesg);
+        num_enqueued++;
         LOG(LogDebug, << "Exchange_Topic delivering message; " << smesg
                       << " to subscription " << (i+1) << "; " << subs[i] << std::endl);
       } // for
+
+      if (!num_enqueued) {
+        // no matching subs so we drop this packet
+        dispatched(smesg);
+        num_deferred++;
+        continue;
+      } // if
+
       num_dispatched++;
       dispatched(smesg);
     } // for
@@ -77,7 +79,8 @@ namespace stomp {
     datapoint("num.dispatched", num);
     datapoint("num.deferred", num_deferred);
 
-    return num_dispatched;
+    // everything taken off the queue counts against the dispatch share
+    return num;
   } // Exchange_Topic::dispatch
 
 //  std::ostream &operator<<(std::ostream &ss, const Exchange *exch) {
@@ -0,0 +1,589 @@
+#include "config.h"
+
+#include <string>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <sstream>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <openframe/openframe.h>
+
+#include "Selector.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** Selector Class                                                       **
+ **************************************************************************/
+  const size_t Selector::kMaxLength		= 4096;
+  const size_t Selector::kMaxNesting		= 64;
+
+  Selector::Selector(const std::string &expr)
+           : _expr(expr),
+             _depth(0),
+             _max_depth(0),
+             _nesting(0),
+             _pos(0) {
+    if (_expr.length() > kMaxLength) fail("longer than "+stringify<int>(kMaxLength));
+
+    next_token();
+    parse_or();
+    if (_token.type != tokenEnd) fail("unexpected '"+_token.text+"'");
+    assert(_depth == 1);	// bug
+
+    _stack.resize(_max_depth);
+  } // Selector::Selector
+
+  Selector::~Selector() {
+  } // Selector::~Selector
+
+  void Selector::fail(const std::string &reason) const {
+    throw StompInvalidSelector_Exception(reason, _token.pos);
+  } // Selector::fail
+
+  Selector::op_t Selector::new_op(const opcodeEnum code) {
+    op_t op;
+    op.op = code;
+    op.negate = false;
+    op.boolean = false;
+    op.number = 0;
+    return op;
+  } // Selector::new_op
+
+  void Selector::emit(const op_t &op, const int depth) {
+    _code.push_back(op);
+    _depth += depth;
+    if (_depth > _max_depth) _max_depth = _depth;
+  } // Selector::emit
+
+  void Selector::next_token() {
+    const size_t len = _expr.length();
+    while(_pos < len && isspace( (unsigned char) _expr[_pos] )) _pos++;
+
+    _token.pos = _pos;
+    _token.text.clear();
+    _token.number = 0;
+    if (_pos >= len) {
+      _token.type = tokenEnd;
+      return;
+    } // if
+
+    char c = _expr[_pos];
+    char next = (_pos + 1 < len ? _expr[_pos + 1] : '\0');
+
+    // 'literal' and "identifier", a doubled quote stands for itself
+    if (c == '\'' || c == '"') {
+      _token.type = (c == '\'' ? tokenString : tokenIdent);
+      for(_pos++; ; _pos++) {
+        if (_pos >= len) fail("unterminated quote");
+        if (_expr[_pos] != c) {
+          _token.text.append(1, _expr[_pos]);
+          continue;
+        } // if
+        if (_pos + 1 < len && _expr[_pos + 1] == c) {
+          _token.text.append(1, c);
+          _pos++;
+          continue;
+        } // if
+        _pos++;
+        break;
+      } // for
+      return;
+    } // if
+
+    if (isdigit( (unsigned char) c ) || ((c == '-' || c == '.') && (isdigit( (unsigned char) next ) || next == '.'))) {
+      size_t start = _pos;
+      if (c == '-') _pos++;
+      while(_pos < len && (isdigit( (unsigned char) _expr[_pos] ) || _expr[_pos] == '.')) _pos++;
+      if (_pos < len && (_expr[_pos] == 'e' || _expr[_pos] == 'E')) {
+        _pos++;
+        if (_pos < len && (_expr[_pos] == '-' || _expr[_pos] == '+')) _pos++;
+        while(_pos < len && isdigit( (unsigned char) _expr[_pos] )) _pos++;
+      } // if
+      _token.type = tokenNumber;
+      _token.text = _expr.substr(start, _pos - start);
+
+      value_t v;
+      v.type = valueString;
+      v.str = StompSlice(_token.text);
+      if ( !to_number(v, _token.number) ) fail("bad number '"+_token.text+"'");
+      return;
+    } // if
+
+    if (isalpha( (unsigned char) c ) || c == '_' || c == '$') {
+      size_t start = _pos;
+      while(_pos < len) {
+        c = _expr[_pos];
+        if (!isalnum( (unsigned char) c ) && c != '_' && c != '$' && c != '.' && c != '-' && c != ':') break;
+        _pos++;
+      } // while
+      _token.type = tokenIdent;
+      _token.text = _expr.substr(start, _pos - start);
+      return;
+    } // if
+
+    static const char *symbols[] = { "<>", "!=", "<=", ">=", "=", "<", ">", "(", ")", ",", NULL };
+    for(size_t i=0; symbols[i] != NULL; i++) {
+      size_t n = strlen(symbols[i]);
+      if (_expr.compare(_pos, n, symbols[i]) != 0) continue;
+      _token.type = tokenSymbol;
+      _token.text = (strcmp(symbols[i], "!=") == 0 ? "<>" : symbols[i]);
+      _pos += n;
+      return;
+    } // for
+
+    fail("unexpected '"+std::string(1, c)+"'");
+  } // Selector::next_token
+
+  bool Selector::is_keyword(const char *word) const {
+    return (_token.type == tokenIdent && strcasecmp(_token.text.c_str(), word) == 0);
+  } // Selector::is_keyword
+
+  bool Selector::is_symbol(const char *symbol) const {
+    return (_token.type == tokenSymbol && _token.text == symbol);
+  } // Selector::is_symbol
+
+  void Selector::expect_keyword(const char *word) {
+    if ( !is_keyword(word) ) fail("expected "+std::string(word));
+    next_token();
+  } // Selector::expect_keyword
+
+  void Selector::expect_symbol(const char *symbol) {
+    if ( !is_symbol(symbol) ) fail("expected '"+std::string(symbol)+"'");
+    next_token();
+  } // Selector::expect_symbol
+
+  void Selector::parse_or() {
+    parse_and();
+    while( is_keyword("OR") ) {
+      next_token();
+      parse_and();
+      op_t op = new_op(opOr);
+      emit(op, -1);
+    } // while
+  } // Selector::parse_or
+
+  void Selector::parse_and() {
+    parse_not();
+    while( is_keyword("AND") ) {
+      next_token();
+      parse_not();
+      op_t op = new_op(opAnd);
+      emit(op, -1);
+    } // while
+  } // Selector::parse_and
+
+  void Selector::parse_not() {
+    if ( !is_keyword("NOT") ) {
+      parse_predicate();
+      return;
+    } // if
+
+    if (++_nesting > kMaxNesting) fail("nested too deep");
+    next_token();
+    parse_not();
+    _nesting--;
+
+    op_t op = new_op(opNot);
+    emit(op, 0);
+  } // Selector::parse_not
+
+  void Selector::parse_predicate() {
+    parse_operand();
+
+    static const struct {
+      const char *symbol;
+      opcodeEnum op;
+    } comparisons[] = {
+      { "=", opEqual },
+      { "<>", opNotEqual },
+      { "<", opLess },
+      { "<=", opLessEqual },
+      { ">", opGreater },
+      { ">=", opGreaterEqual },
+      { NULL, opEqual }
+    };
+
+    for(size_t i=0; comparisons[i].symbol != NULL; i++) {
+      if ( !is_symbol(comparisons[i].symbol) ) continue;
+      next_token();
+      parse_operand();
+      op_t op = new_op(comparisons[i].op);
+      emit(op, -1);
+      return;
+    } // for
+
+    op_t op = new_op(opLike);
+    if ( is_keyword("NOT") ) {
+      op.negate = true;
+      next_token();
+    } // if
+
+    if ( is_keyword("LIKE") ) {
+      next_token();
+      std::string pattern = parse_string();
+      char escape = '\0';
+      if ( is_keyword("ESCAPE") ) {
+        next_token();
+        std::string esc = parse_string();
+        if (esc.length() != 1) fail("escape must be one character");
+        escape = esc[0];
+      } // if
+      op.op = opLike;
+      compile_like(pattern, escape, op.like);
+      emit(op, 0);
+    } // if
+    else if ( is_keyword("IN") ) {
+      next_token();
+      expect_symbol("(");
+      op.list.push_back( parse_string() );
+      while( is_symbol(",") ) {
+        next_token();
+        op.list.push_back( parse_string() );
+      } // while
+      expect_symbol(")");
+      op.op = opIn;
+      emit(op, 0);
+    } // else if
+    else if ( is_keyword("BETWEEN") ) {
+      next_token();
+      parse_operand();
+      expect_keyword("AND");
+      parse_operand();
+      op.op = opBetween;
+      emit(op, -2);
+    } // else if
+    else if ( !op.negate && is_keyword("IS") ) {
+      next_token();
+      if ( is_keyword("NOT") ) {
+        op.negate = true;
+        next_token();
+      } // if
+      expect_keyword("NULL");
+      op.op = opIsNull;
+      emit(op, 0);
+    } // else if
+    else if (op.negate)
+      fail("expected LIKE, IN or BETWEEN");
+  } // Selector::parse_predicate
+
+  void Selector::parse_operand() {
+    static const char *reserved[] = { "AND", "OR", "NOT", "LIKE", "IN", "IS", "NULL", "BETWEEN", "ESCAPE", NULL };
+
+    op_t op = new_op(opHeader);
+    switch(_token.type) {
+      case tokenSymbol:
+        if ( !is_symbol("(") ) fail("unexpected '"+_token.text+"'");
+        if (++_nesting > kMaxNesting) fail("nested too deep");
+        next_token();
+        parse_or();
+        expect_symbol(")");
+        _nesting--;
+        return;
+      case tokenIdent:
+        if ( is_keyword("TRUE") || is_keyword("FALSE") ) {
+          op.op = opBoolean;
+          op.boolean = is_keyword("TRUE");
+          break;
+        } // if
+        for(size_t i=0; reserved[i] != NULL; i++) {
+          if ( is_keyword(reserved[i]) ) fail("unexpected "+_token.text);
+        } // for
+        op.op = opHeader;
+        op.str = _token.text;
+        break;
+      case tokenString:
+        op.op = opString;
+        op.str = _token.text;
+        break;
+      case tokenNumber:
+        op.op = opNumber;
+        op.number = _token.number;
+        break;
+      case tokenEnd:
+      default:
+        fail("expected a header or value");
+    } // switch
+
+    next_token();
+    emit(op, 1);
+  } // Selector::parse_operand
+
+  std::string Selector::parse_string() {
+    if (_token.type != tokenString) fail("expected a quoted string");
+    std::string ret = _token.text;
+    next_token();
+    return ret;
+  } // Selector::parse_string
+
+  void Selector::compile_like(const std::string &pattern, const char escape, std::vector<like_t> &ret) {
+    for(size_t i=0; i < pattern.length(); i++) {
+      like_t l;
+      l.c = pattern[i];
+      if (escape && l.c == escape) {
+        if (++i == pattern.length()) fail("pattern ends in escape");
+        l.type = likeChar;
+        l.c = pattern[i];
+      } // if
+      else if (l.c == '%') {
+        if (!ret.empty() && ret.back().type == likeAny) continue;
+        l.type = likeAny;
+      } // else if
+      else if (l.c == '_')
+        l.type = likeOne;
+      else
+        l.type = likeChar;
+      ret.push_back(l);
+    } // for
+  } // Selector::compile_like
+
+  // -1 unknown, 0 false, 1 true
+  int Selector::logic(const value_t &v) {
+    switch(v.type) {
+      case valueBoolean:
+        return v.boolean ? 1 : 0;
+      case valueString:
+        if (v.str.length() == 4 && strncasecmp(v.str.data(), "true", 4) == 0) return 1;
+        if (v.str.length() == 5 && strncasecmp(v.str.data(), "false", 5) == 0) return 0;
+        return -1;
+      case valueNull:
+      case valueNumber:
+      default:
+        return -1;
+    } // switch
+  } // Selector::logic
+
+  void Selector::set_logic(value_t &v, const int logic) {
+    if (logic < 0) {
+      v.type = valueNull;
+      return;
+    } // if
+    v.type = valueBoolean;
+    v.boolean = (logic == 1);
+  } // Selector::set_logic
+
+  // parses the slice in place, header values are not nul terminated
+  bool Selector::to_number(const value_t &v, double &ret) {
+    if (v.type == valueNumber) {
+      ret = v.number;
+      return true;
+    } // if
+    if (v.type != valueString) return false;
+
+    const char *p = v.str.data();
+    const char *end = p + v.str.length();
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    double mantissa = 0;
+    int scale = 0;
+    size_t num_digits = 0;
+    for(; p < end && isdigit( (unsigned char) *p ); p++, num_digits++) mantissa = mantissa * 10 + (*p - '0');
+    if (p < end && *p == '.') {
+      for(p++; p < end && isdigit( (unsigned char) *p ); p++, num_digits++) {
+        mantissa = mantissa * 10 + (*p - '0');
+        scale--;
+      } // for
+    } // if
+    if (!num_digits) return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      p++;
+      bool exp_negative = false;
+      if (p < end && (*p == '-' || *p == '+')) exp_negative = (*p++ == '-');
+      int exponent = 0;
+      size_t num_exp_digits = 0;
+      for(; p < end && isdigit( (unsigned char) *p ) && exponent < 10000; p++, num_exp_digits++) exponent = exponent * 10 + (*p - '0');
+      if (!num_exp_digits) return false;
+      scale += (exp_negative ? -exponent : exponent);
+    } // if
+    if (p != end) return false;
+
+    ret = mantissa * pow(10.0, scale);
+    if (negative) ret = -ret;
+    return true;
+  } // Selector::to_number
+
+  // strings compare as strings, anything against a number as numbers and
+  // anything against a boolean as booleans, NULL never compares
+  int Selector::compare(const value_t &a, const value_t &b, bool &known) {
+    known = false;
+    if (a.type == valueNull || b.type == valueNull) return 0;
+
+    if (a.type == valueString && b.type == valueString) {
+      known = true;
+      size_t len = std::min(a.str.length(), b.str.length());
+      int ret = memcmp(a.str.data(), b.str.data(), len);
+      if (ret) return ret;
+      return (a.str.length() < b.str.length() ? -1 : (a.str.length() > b.str.length() ? 1 : 0));
+    } // if
+
+    if (a.type == valueNumber || b.type == valueNumber) {
+      double x, y;
+      if ( !to_number(a, x) || !to_number(b, y) ) return 0;
+      known = true;
+      return (x < y ? -1 : (x > y ? 1 : 0));
+    } // if
+
+    int x = logic(a);
+    int y = logic(b);
+    if (x < 0 || y < 0) return 0;
+    known = true;
+    return x - y;
+  } // Selector::compare
+
+  bool Selector::like(const StompSlice &str, const std::vector<like_t> &pattern) {
+    const char *s = str.data();
+    const size_t len = str.length();
+    const size_t n = pattern.size();
+    size_t i = 0, p = 0;
+    size_t star = n, star_i = 0;
+
+    while(i < len) {
+      if (p < n && (pattern[p].type == likeOne || (pattern[p].type == likeChar && pattern[p].c == s[i]))) {
+        i++;
+        p++;
+      } // if
+      else if (p < n && pattern[p].type == likeAny) {
+        star = p++;
+        star_i = i;
+      } // else if
+      else if (star < n) {
+        // let the last % take one more character and retry
+        p = star + 1;
+        i = ++star_i;
+      } // else if
+      else
+        return false;
+    } // while
+
+    while(p < n && pattern[p].type == likeAny) p++;
+    return p == n;
+  } // Selector::like
+
+  const bool Selector::match(const StompHeaders *headers) const {
+    size_t sp = 0;
+
+    for(std::vector<op_t>::size_type pc=0; pc < _code.size(); pc++) {
+      const op_t &op = _code[pc];
+      switch(op.op) {
+        case opHeader: {
+          value_t &v = _stack[sp++];
+          v.type = headers->find_header(op.str.data(), op.str.length(), v.str) ? valueString : valueNull;
+          break;
+        } // opHeader
+        case opString: {
+          value_t &v = _stack[sp++];
+          v.type = valueString;
+          v.str = StompSlice(op.str);
+          break;
+        } // opString
+        case opNumber: {
+          value_t &v = _stack[sp++];
+          v.type = valueNumber;
+          v.number = op.number;
+          break;
+        } // opNumber
+        case opBoolean: {
+          value_t &v = _stack[sp++];
+          v.type = valueBoolean;
+          v.boolean = op.boolean;
+          break;
+        } // opBoolean
+        case opEqual:
+        case opNotEqual:
+        case opLess:
+        case opLessEqual:
+        case opGreater:
+        case opGreaterEqual: {
+          const value_t &b = _stack[--sp];
+          value_t &a = _stack[sp - 1];
+          bool known;
+          int c = compare(a, b, known);
+          int r = -1;
+          if (known) {
+            switch(op.op) {
+              case opEqual: r = (c == 0); break;
+              case opNotEqual: r = (c != 0); break;
+              case opLess: r = (c < 0); break;
+              case opLessEqual: r = (c <= 0); break;
+              case opGreater: r = (c > 0); break;
+              case opGreaterEqual: r = (c >= 0); break;
+              default: break;
+            } // switch
+          } // if
+          set_logic(a, r);
+          break;
+        } // comparisons
+        case opLike: {
+          value_t &a = _stack[sp - 1];
+          int r = -1;
+          if (a.type == valueString) r = like(a.str, op.like);
+          if (r >= 0 && op.negate) r = !r;
+          set_logic(a, r);
+          break;
+        } // opLike
+        case opIn: {
+          value_t &a = _stack[sp - 1];
+          int r = -1;
+          if (a.type == valueString) {
+            r = 0;
+            for(size_t i=0; i < op.list.size() && !r; i++) r = a.str.is(op.list[i]);
+            if (op.negate) r = !r;
+          } // if
+          set_logic(a, r);
+          break;
+        } // opIn
+        case opBetween: {
+          const value_t &hi = _stack[--sp];
+          const value_t &lo = _stack[--sp];
+          value_t &a = _stack[sp - 1];
+          bool known_lo, known_hi;
+          int c_lo = compare(a, lo, known_lo);
+          int c_hi = compare(a, hi, known_hi);
+          // a >= lo AND a <= hi in three valued logic
+          int r;
+          if ((known_lo && c_lo < 0) || (known_hi && c_hi > 0)) r = 0;
+          else if (known_lo && known_hi) r = 1;
+          else r = -1;
+          if (r >= 0 && op.negate) r = !r;
+          set_logic(a, r);
+          break;
+        } // opBetween
+        case opIsNull: {
+          value_t &a = _stack[sp - 1];
+          bool r = (a.type == valueNull);
+          set_logic(a, (op.negate ? !r : r));
+          break;
+        } // opIsNull
+        case opNot: {
+          value_t &a = _stack[sp - 1];
+          int r = logic(a);
+          set_logic(a, (r < 0 ? r : !r));
+          break;
+        } // opNot
+        case opAnd:
+        case opOr: {
+          int y = logic(_stack[--sp]);
+          value_t &a = _stack[sp - 1];
+          int x = logic(a);
+          int r;
+          if (op.op == opAnd)
+            r = ((x == 0 || y == 0) ? 0 : ((x == 1 && y == 1) ? 1 : -1));
+          else
+            r = ((x == 1 || y == 1) ? 1 : ((x == 0 && y == 0) ? 0 : -1));
+          set_logic(a, r);
+          break;
+        } // opAnd, opOr
+      } // switch
+    } // for
+
+    return (sp == 1 && logic(_stack[0]) == 1);
+  } // Selector::match
+} // namespace stomp
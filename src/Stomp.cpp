@@ -115,7 +115,7 @@ namespace stomp {
       } // catch
 
       if (ok) {
-        if (frame->is_command("CONNECTED")) {
+        if (frame->is_command(StompFrame::commandConnected)) {
           frame->release();
           return true;
         } // if
@@ -7,6 +7,9 @@
 #include <new>
 #include <iostream>
 
+#include <ctype.h>
+#include <strings.h>
+
 #include <openframe/openframe.h>
 
 #include "StompFrame.h"
@@ -21,68 +24,159 @@ namespace stomp {
 /**************************************************************************
  ** StompFrame Class                                                     **
  **************************************************************************/
+  // indexed by commandEnum, commandUnknown is not in the table
+  static const struct {
+    const char *name;
+    size_t length;
+  } kCommands[] = {
+    { "CONNECT",	7 },
+    { "STOMP",		5 },
+    { "CONNECTED",	9 },
+    { "SEND",		4 },
+    { "SUBSCRIBE",	9 },
+    { "UNSUBSCRIBE",	11 },
+    { "BEGIN",		5 },
+    { "COMMIT",		6 },
+    { "ACK",		3 },
+    { "DISCONNECT",	10 },
+    { "MESSAGE",	7 },
+    { "RECEIPT",	7 },
+    { "ERROR",		5 },
+    { "ABORT",		5 },
+    { "NACK",		4 }
+  };
+
   StompFrame::StompFrame(const string &command, const string &body)
              : _requires_resp(true),
                _execute_transaction(false),
                _command(command),
-               _body(body),
+               _payload( StompPayload::create(body.data(), body.length()) ),
+               _created( time(NULL) ),
+               _updated( time(NULL) ),
+               _type( classify(command.data(), command.length()) ) {
+  } // StompFrame::StompFrame
+
+  StompFrame::StompFrame(const commandEnum type, const string &body)
+             : _requires_resp(true),
+               _execute_transaction(false),
+               _command( command_str(type) ),
+               _payload( StompPayload::create(body.data(), body.length()) ),
                _created( time(NULL) ),
-               _updated( time(NULL) ) {
-    if (is_command("CONNECT"))
-      _type = commandConnect;
-    else if (is_command("STOMP"))
-      _type = commandStomp;
-    else if (is_command("CONNECTED"))
-      _type = commandConnected;
-    else if (is_command("SEND"))
-      _type = commandSend;
-    else if (is_command("SUBSCRIBE"))
-      _type = commandSubscribe;
-    else if (is_command("UNSUBSCRIBE"))
-      _type = commandUnsubscribe;
-    else if (is_command("BEGIN"))
-      _type = commandBegin;
-    else if (is_command("COMMIT"))
-      _type = commandCommit;
-    else if (is_command("ABORT"))
-      _type = commandAbort;
-    else if (is_command("ACK"))
-      _type = commandAck;
-    else if (is_command("NACK"))
-      _type = commandNack;
-    else if (is_command("DISCONNECT"))
-      _type = commandDisconnect;
-    else if (is_command("MESSAGE"))
-      _type = commandMessage;
-    else if (is_command("RECEIPT"))
-      _type = commandReceipt;
-    else if (is_command("ERROR"))
-      _type = commandError;
-    else
-      _type = commandUnknown;
+               _updated( time(NULL) ),
+               _type(type) {
+  } // StompFrame::StompFrame
+
+  StompFrame::StompFrame(const commandEnum type, const char *body, const size_t body_len)
+             : _requires_resp(true),
+               _execute_transaction(false),
+               _command( command_str(type) ),
+               _payload( StompPayload::create(body, body_len) ),
+               _created( time(NULL) ),
+               _updated( time(NULL) ),
+               _type(type) {
+  } // StompFrame::StompFrame
+
+  StompFrame::StompFrame(const commandEnum type, StompPayload *payload)
+             : _requires_resp(true),
+               _execute_transaction(false),
+               _command( command_str(type) ),
+               _payload(payload),
+               _created( time(NULL) ),
+               _updated( time(NULL) ),
+               _type(type) {
+    assert(payload != NULL); // bug
+    _payload->retain();
   } // StompFrame::StompFrame
 
   StompFrame::~StompFrame() {
+    _payload->release();
   } // StompFrame::~StompFrame
 
+  StompFrame::commandEnum StompFrame::classify(const char *command, const size_t len) {
+    commandEnum ret = commandUnknown;
+
+    // length and first byte leave at most one candidate, confirm it
+    switch(len) {
+      case 3:
+        ret = commandAck;
+        break;
+      case 4:
+        switch( toupper( (unsigned char) command[0] ) ) {
+          case 'S': ret = commandSend; break;
+          case 'N': ret = commandNack; break;
+        } // switch
+        break;
+      case 5:
+        switch( toupper( (unsigned char) command[0] ) ) {
+          case 'S': ret = commandStomp; break;
+          case 'B': ret = commandBegin; break;
+          case 'A': ret = commandAbort; break;
+          case 'E': ret = commandError; break;
+        } // switch
+        break;
+      case 6:
+        ret = commandCommit;
+        break;
+      case 7:
+        switch( toupper( (unsigned char) command[0] ) ) {
+          case 'C': ret = commandConnect; break;
+          case 'M': ret = commandMessage; break;
+          case 'R': ret = commandReceipt; break;
+        } // switch
+        break;
+      case 9:
+        switch( toupper( (unsigned char) command[0] ) ) {
+          case 'C': ret = commandConnected; break;
+          case 'S': ret = commandSubscribe; break;
+        } // switch
+        break;
+      case 10:
+        ret = commandDisconnect;
+        break;
+      case 11:
+        ret = commandUnsubscribe;
+        break;
+    } // switch
+
+    if (ret == commandUnknown) return ret;
+    return strncasecmp(command, kCommands[ret].name, len) == 0 ? ret : commandUnknown;
+  } // StompFrame::classify
+
+  const string StompFrame::command_str(const commandEnum type) {
+    if (type == commandUnknown) return "UNKNOWN";
+    return string(kCommands[type].name, kCommands[type].length);
+  } // StompFrame::command_str
+
   const string StompFrame::compile() {
-    stringstream out;
-    replace_header("Content-Length", stringify<size_t>(_body.length() ) );
-    out.str("");
-    out << _command
-        << endl
-        << headers()
-        << endl
-        << _body
-        << '\0' << endl;
-    return out.str();
+    string ret;
+    compile(ret);
+    return ret;
+  } // StompFrame::compile
+
+  // appends the wire form to out after sizing it exactly, so a reused
+  // buffer never grows more than once per frame
+  const size_t StompFrame::compile(string &out) {
+    replace_header(headerContentLength, stringify<size_t>(_payload->length() ) );
+
+    size_t len = _command.length() + 1
+                 + headers_length() + 1
+                 + _payload->length() + 2;
+    out.reserve(out.length() + len);
+    out.append(_command);
+    out.append(1, '\n');
+    append_headers(out);
+    out.append(1, '\n');
+    out.append(_payload->str());
+    out.append(1, '\0');
+    out.append(1, '\n');
+    return len;
   } // StompFrame::compile
 
   const string StompFrame::toString() const {
     stringstream out;
     out << "StompFrame "
         << "command=" << _command
-        << ",body=" << _body;
+        << ",body=" << _payload->str();
 //        << headersToString();
 
      return out.str();
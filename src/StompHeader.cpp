@@ -65,8 +65,11 @@ namespace stomp {
   } // StompHeader::toString
 
   const string StompHeader::compile() const {
-    stringstream out;
-    out << _name << ":" << _value;
-    return out.str();
+    string ret;
+    ret.reserve(_name.length() + _value.length() + 1);
+    ret.append(_name);
+    ret.append(1, ':');
+    ret.append(_value);
+    return ret;
   } // StompHeader::compile
 } // namespace stomp
@@ -3,10 +3,15 @@
 #include <set>
 #include <string>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <map>
 #include <new>
 #include <iostream>
 
+#include <ctype.h>
+#include <strings.h>
+
 #include <openframe/openframe.h>
 
 #include "StompHeader.h"
@@ -17,95 +22,387 @@ namespace stomp {
 /**************************************************************************
  ** StompHeaders Class                                                   **
  **************************************************************************/
-  StompHeaders::StompHeaders() {
+  // indexed by headerEnum
+  static const struct {
+    const char *name;
+    size_t length;
+  } kKnownHeaders[] = {
+    { "destination",	11 },
+    { "message-id",	10 },
+    { "subscription",	12 },
+    { "transaction",	11 },
+    { "receipt",	7 },
+    { "receipt-id",	10 },
+    { "id",		2 },
+    { "ack",		3 },
+    { "Content-Length",	14 },
+    { "content-type",	12 },
+    { "login",		5 },
+    { "passcode",	8 },
+    { "heart-beat",	10 },
+    { "message",	7 },
+    { "session",	7 }
+  };
+
+  StompHeaders::StompHeaders()
+               : _headers(_inline_headers),
+                 _num_headers(0),
+                 _max_headers(kInlineHeaders),
+                 _bytes(_inline_bytes),
+                 _num_bytes(0),
+                 _max_bytes(kInlineBytes),
+                 _dead_bytes(0),
+                 _version(0) {
+    memset(_slots, 0xff, sizeof(_slots));
   } // StompHeaders::StompHeaders
 
-  StompHeaders::StompHeaders(const std::string &name, const std::string &value) {
+  StompHeaders::StompHeaders(const std::string &name, const std::string &value)
+               : _headers(_inline_headers),
+                 _num_headers(0),
+                 _max_headers(kInlineHeaders),
+                 _bytes(_inline_bytes),
+                 _num_bytes(0),
+                 _max_bytes(kInlineBytes),
+                 _dead_bytes(0),
+                 _version(0) {
+    memset(_slots, 0xff, sizeof(_slots));
     add_header(name, value);
   } // StompHeaders::StompHeaders
 
   StompHeaders::~StompHeaders() {
-    // free all of our headers
-    for(stompHeader_itr itr = begin(); itr != end(); itr++) {
-      StompHeader *header = itr->second;
-      header->release();
-    } // for
+    if (_headers != _inline_headers) free(_headers);
+    if (_bytes != _inline_bytes) free(_bytes);
   } // StompHeaders::~StompHeaders
 
   StompHeaders &StompHeaders::add_header(const std::string &name, const std::string &value) {
-    if (!is_header(name))
-      insert( make_pair(name, new StompHeader(name, value)) );
-    return dynamic_cast<StompHeaders &>(*this);
+    return add_header(name.data(), name.length(), value.data(), value.length());
+  } // StompHeaders::add_header
+
+  StompHeaders &StompHeaders::add_header(const char *name, const size_t name_len, const char *value, const size_t value_len) {
+    return add_header(classify(name, name_len), name, name_len, value, value_len);
+  } // StompHeaders::add_header
+
+  StompHeaders &StompHeaders::add_header(const headerEnum known, const char *name, const size_t name_len, const char *value, const size_t value_len) {
+    if (find(known, name, name_len) == _num_headers)
+      insert(known, name, name_len, value, value_len);
+    return *this;
+  } // StompHeaders::add_header
+
+  StompHeaders &StompHeaders::add_header(const headerEnum known, const std::string &value) {
+    assert(known != headerUnknown);	// bug
+    return add_header(known, kKnownHeaders[known].name, kKnownHeaders[known].length, value.data(), value.length());
   } // StompHeaders::add_header
 
   StompHeaders &StompHeaders::replace_header(const std::string &name, const std::string &value) {
-    if (is_header(name)) remove_header(name);
-    insert( make_pair(name, new StompHeader(name, value)) );
-    return dynamic_cast<StompHeaders &>(*this);
+    headerEnum known = classify(name.data(), name.length());
+    size_t i = find(known, name.data(), name.length());
+    if (i == _num_headers)
+      insert(known, name.data(), name.length(), value.data(), value.length());
+    else
+      assign(i, value.data(), value.length());
+    return *this;
+  } // StompHeaders::replace_header
+
+  StompHeaders &StompHeaders::replace_header(const headerEnum known, const std::string &value) {
+    return replace_header(known, value.data(), value.length());
+  } // StompHeaders::replace_header
+
+  StompHeaders &StompHeaders::replace_header(const headerEnum known, const char *value, const size_t value_len) {
+    assert(known != headerUnknown);	// bug
+    if (!is_header(known))
+      insert(known, kKnownHeaders[known].name, kKnownHeaders[known].length, value, value_len);
+    else
+      assign(_slots[known], value, value_len);
+    return *this;
   } // StompHeaders::replace_header
 
   StompHeaders &StompHeaders::replace_header(StompHeader *header) {
-    if (is_header( header->name() )) remove_header( header->name() );
-    header->retain();
-    insert( make_pair(header->name(), header) );
-    return dynamic_cast<StompHeaders &>(*this);
+    return replace_header(header->name(), header->value());
   } // StompHeaders::replace_header
 
   StompHeaders &StompHeaders::remove_header(const std::string &name) {
-      stompHeader_itr itr = find(name);
-      if (itr == end()) throw StompNoSuchHeader_Exception(name);
-      StompHeader *header = itr->second;
-      header->release();
-      erase(itr);
-      return dynamic_cast<StompHeaders &>(*this);
+    size_t i = find(name.data(), name.length());
+    if (i == _num_headers) throw StompNoSuchHeader_Exception(name);
+    erase(i);
+    return *this;
   } // StompHeaders::remove_header
 
   StompHeaders &StompHeaders::copy_headers_from(const StompHeaders *headers) {
-    for(stompHeader_citr citr = headers->begin(); citr != headers->end(); citr++) {
-      StompHeader *header = citr->second;
-      replace_header(header);
+    if (headers == this) return *this;
+
+    for(size_t j=0; j < headers->_num_headers; j++) {
+      const header_t &header = headers->_headers[j];
+      const char *name = headers->_bytes + header.name;
+      const char *value = headers->_bytes + header.value;
+      headerEnum known = (headerEnum) header.known;
+      size_t i = find(known, name, header.name_len);
+      if (i == _num_headers)
+        insert(known, name, header.name_len, value, header.value_len);
+      else
+        assign(i, value, header.value_len);
     } // for
-    return dynamic_cast<StompHeaders &>(*this);
+    return *this;
   } // StompHeaders::copy_headers_from
 
-  const std::string StompHeaders::get_header(const std::string &name) {
-    stompHeader_itr itr = find(name);
-    if (itr == end()) throw StompNoSuchHeader_Exception(name);
+  const std::string StompHeaders::get_header(const std::string &name) const {
+    size_t i = find(name.data(), name.length());
+    if (i == _num_headers) throw StompNoSuchHeader_Exception(name);
 
-    return itr->second->value();
+    return header_value(i).str();
   } // StompHeaders::get_header
 
-  const std::string StompHeaders::get_header(const std::string &name, const std::string &def) {
-    stompHeader_itr itr = find(name);
-    if (itr == end()) return def;
+  const std::string StompHeaders::get_header(const std::string &name, const std::string &def) const {
+    size_t i = find(name.data(), name.length());
+    if (i == _num_headers) return def;
 
-    return itr->second->value();
+    return header_value(i).str();
   } // StompHeaders::get_header
 
-  const bool StompHeaders::get_header(const std::string &name, StompHeader *&header) {
-    stompHeader_itr itr = find(name);
-    if (itr == end()) return false;
-    header = itr->second;
-    return true;
+  const std::string StompHeaders::get_header(const headerEnum known) const {
+    if (!is_header(known)) throw StompNoSuchHeader_Exception( header_str(known) );
+    return header_value(_slots[known]).str();
+  } // StompHeaders::get_header
+
+  const std::string StompHeaders::get_header(const headerEnum known, const std::string &def) const {
+    if (!is_header(known)) return def;
+    return header_value(_slots[known]).str();
   } // StompHeaders::get_header
 
-  const bool StompHeaders::is_header(const std::string &name) {
-    StompHeader *header = NULL;
-    return get_header(name, header);
+  const bool StompHeaders::is_header(const std::string &name) const {
+    return find(name.data(), name.length()) != _num_headers;
   } // StompHeaders::is_header
 
+  // no copies made, ret points into the arena
+  const bool StompHeaders::find_header(const char *name, const size_t len, StompSlice &ret) const {
+    size_t i = find(name, len);
+    if (i == _num_headers) return false;
+    ret = header_value(i);
+    return true;
+  } // StompHeaders::find_header
+
   const std::string StompHeaders::headersToString() const {
-    stompHeader_t::const_iterator itr;
     std::stringstream out;
 
-    for(itr = begin(); itr != end(); itr++)
-      out << itr->second->toString() << std::endl;
+    for(size_t i=0; i < _num_headers; i++) {
+      out << "Header "
+          << "name=" << header_name(i).str()
+          << ",value=" << StringTool::safe( header_value(i).str() )
+          << std::endl;
+    } // for
 
     return out.str();
   } // StompHeaders::headersToString
 
+  StompHeaders::headerEnum StompHeaders::classify(const char *name, const size_t len) {
+    headerEnum ret = headerUnknown;
+
+    // pick the only possible candidate then confirm it
+    switch(len) {
+      case 2:
+        ret = headerId;
+        break;
+      case 3:
+        ret = headerAck;
+        break;
+      case 5:
+        ret = headerLogin;
+        break;
+      case 7:
+        switch( tolower( (unsigned char) name[0] ) ) {
+          case 'r': ret = headerReceipt; break;
+          case 'm': ret = headerMessage; break;
+          case 's': ret = headerSession; break;
+        } // switch
+        break;
+      case 8:
+        ret = headerPasscode;
+        break;
+      case 10:
+        switch( tolower( (unsigned char) name[0] ) ) {
+          case 'm': ret = headerMessageId; break;
+          case 'r': ret = headerReceiptId; break;
+          case 'h': ret = headerHeartBeat; break;
+        } // switch
+        break;
+      case 11:
+        switch( tolower( (unsigned char) name[0] ) ) {
+          case 'd': ret = headerDestination; break;
+          case 't': ret = headerTransaction; break;
+        } // switch
+        break;
+      case 12:
+        switch( tolower( (unsigned char) name[0] ) ) {
+          case 's': ret = headerSubscription; break;
+          case 'c': ret = headerContentType; break;
+        } // switch
+        break;
+      case 14:
+        ret = headerContentLength;
+        break;
+    } // switch
+
+    if (ret == headerUnknown) return ret;
+    return strncasecmp(name, kKnownHeaders[ret].name, len) == 0 ? ret : headerUnknown;
+  } // StompHeaders::classify
+
+  const std::string StompHeaders::header_str(const headerEnum known) {
+    if (known == headerUnknown) return "unknown";
+    return std::string(kKnownHeaders[known].name, kKnownHeaders[known].length);
+  } // StompHeaders::header_str
+
   // Private
-  const stompHeaderSize_t StompHeaders::headers(ByteData &buf) {
+  uint32_t StompHeaders::hash(const char *name, const size_t len) {
+    // FNV-1a over the lower cased name
+    uint32_t ret = 2166136261u;
+    for(size_t i=0; i < len; i++) {
+      ret ^= (uint32_t) tolower( (unsigned char) name[i] );
+      ret *= 16777619u;
+    } // for
+    return ret;
+  } // StompHeaders::hash
+
+  size_t StompHeaders::find(const char *name, const size_t len) const {
+    return find(classify(name, len), name, len);
+  } // StompHeaders::find
+
+  size_t StompHeaders::find(const headerEnum known, const char *name, const size_t len) const {
+    if (known != headerUnknown)
+      return is_header(known) ? _slots[known] : _num_headers;
+
+    uint32_t h = hash(name, len);
+    for(size_t i=0; i < _num_headers; i++) {
+      const header_t &header = _headers[i];
+      if (header.hash != h || header.name_len != len) continue;
+      if (strncasecmp(_bytes + header.name, name, len) == 0) return i;
+    } // for
+    return _num_headers;
+  } // StompHeaders::find
+
+  void StompHeaders::insert(const headerEnum known, const char *name, const size_t name_len, const char *value, const size_t value_len) {
+    if (_num_headers == _max_headers) {
+      size_t max_headers = _max_headers * 2;
+      header_t *headers = (header_t *) malloc(max_headers * sizeof(header_t));
+      if (headers == NULL) throw std::bad_alloc();
+      memcpy(headers, _headers, _num_headers * sizeof(header_t));
+      if (_headers != _inline_headers) free(_headers);
+      _headers = headers;
+      _max_headers = max_headers;
+    } // if
+
+    // in the table before the value goes in, a compact() under the
+    // second append() has to move the name with the rest
+    size_t i = _num_headers;
+    header_t &header = _headers[i];
+    header.hash = hash(name, name_len);
+    header.known = known;
+    header.name = append(name, name_len);
+    header.name_len = name_len;
+    header.value = header.name + name_len;
+    header.value_len = 0;
+    _num_headers++;
+
+    uint32_t offset = append(value, value_len);
+    _headers[i].value = offset;
+    _headers[i].value_len = value_len;
+    if (known != headerUnknown) _slots[known] = i;
+    _version++;
+  } // StompHeaders::insert
+
+  void StompHeaders::assign(const size_t i, const char *value, const size_t value_len) {
+    header_t &header = _headers[i];
+    _version++;
+
+    // overwrite in place if it fits, this is the common
+    // case for headers like Content-Length and subscription
+    if (value_len <= header.value_len) {
+      memmove(_bytes + header.value, value, value_len);
+      _dead_bytes += header.value_len - value_len;
+      header.value_len = value_len;
+      return;
+    } // if
+
+    // the old value is dead, drop it from the table too so a compact()
+    // inside append() doesn't carry it over as live
+    _dead_bytes += header.value_len;
+    header.value_len = 0;
+    uint32_t offset = append(value, value_len);
+    _headers[i].value = offset;
+    _headers[i].value_len = value_len;
+  } // StompHeaders::assign
+
+  void StompHeaders::erase(const size_t i) {
+    _version++;
+    _dead_bytes += _headers[i].name_len + _headers[i].value_len;
+    if (_headers[i].known != headerUnknown) _slots[ _headers[i].known ] = kNoSlot;
+
+    memmove(_headers + i, _headers + i + 1, (_num_headers - i - 1) * sizeof(header_t));
+    _num_headers--;
+
+    for(size_t k=0; k < headerUnknown; k++) {
+      if (_slots[k] != kNoSlot && _slots[k] > i) _slots[k]--;
+    } // for
+
+    if (_num_headers == 0) _num_bytes = _dead_bytes = 0;
+  } // StompHeaders::erase
+
+  uint32_t StompHeaders::append(const char *buf, const size_t len) {
+    std::string copy;
+    if (_num_bytes + len > _max_bytes && _dead_bytes >= len) {
+      // buf may point into our own arena, hold a copy across compact()
+      copy.assign(buf, len);
+      buf = copy.data();
+      compact();
+    } // if
+
+    if (_num_bytes + len > _max_bytes) {
+      size_t max_bytes = _max_bytes * 2;
+      while(max_bytes < _num_bytes + len) max_bytes *= 2;
+      char *bytes = (char *) malloc(max_bytes);
+      if (bytes == NULL) throw std::bad_alloc();
+      memcpy(bytes, _bytes, _num_bytes);
+      memcpy(bytes + _num_bytes, buf, len);
+      if (_bytes != _inline_bytes) free(_bytes);
+      _bytes = bytes;
+      _max_bytes = max_bytes;
+    } // if
+    else
+      memmove(_bytes + _num_bytes, buf, len);
+
+    uint32_t offset = _num_bytes;
+    _num_bytes += len;
+    return offset;
+  } // StompHeaders::append
+
+  void StompHeaders::compact() {
+    char *bytes = (char *) malloc(_max_bytes);
+    if (bytes == NULL) throw std::bad_alloc();
+
+    size_t num_bytes = 0;
+    for(size_t i=0; i < _num_headers; i++) {
+      header_t &header = _headers[i];
+      memcpy(bytes + num_bytes, _bytes + header.name, header.name_len);
+      header.name = num_bytes;
+      num_bytes += header.name_len;
+      memcpy(bytes + num_bytes, _bytes + header.value, header.value_len);
+      header.value = num_bytes;
+      num_bytes += header.value_len;
+    } // for
+
+    if (_bytes != _inline_bytes) {
+      free(_bytes);
+      _bytes = bytes;
+    } // if
+    else {
+      memcpy(_inline_bytes, bytes, num_bytes);
+      free(bytes);
+    } // else
+
+    _num_bytes = num_bytes;
+    _dead_bytes = 0;
+  } // StompHeaders::compact
+
+  // Protected
+  const size_t StompHeaders::headers(ByteData &buf) {
     while(buf.nextLength() != 0) {
       std::string line;
       try {
@@ -118,33 +415,39 @@ namespace stomp {
       if (line.length() < 1)
         break;
 
-      openframe::StringToken st;
-      st.setDelimiter(':');
-      st = line;
-
-      if (st.size() < 2)
+      std::string::size_type pos = line.find(':');
+      if (pos == std::string::npos)
         throw StompInvalidHeader_Exception();
 
-      std::string name = st[0];
-      std::string value = st.trail(1);
-
-      StompHeader *header = new StompHeader(name, value);
-      insert( std::make_pair(name, header) );
+      add_header(line.data(), pos, line.data() + pos + 1, line.length() - pos - 1);
     } // while
 
-    return size();
+    return _num_headers;
   } // StompHeaders::headers
 
   const std::string StompHeaders::headers() const {
-    stompHeader_t::const_iterator itr;
-    std::stringstream ret;
+    std::string ret;
+    ret.reserve( headers_length() );
+    append_headers(ret);
+    return ret;
+  } // StompHeaders::headers
+
+  // exact size of the "name:value\n" lines append_headers() writes
+  const size_t StompHeaders::headers_length() const {
+    return (_num_bytes - _dead_bytes) + (_num_headers * 2);
+  } // StompHeaders::headers_length
 
-    for(itr = begin(); itr != end(); itr++) {
-      StompHeader *header = itr->second;
-      ret << header->compile() << std::endl;
+  const size_t StompHeaders::append_headers(std::string &out) const {
+    size_t len = out.length();
+    for(size_t i=0; i < _num_headers; i++) {
+      const header_t &header = _headers[i];
+      out.append(_bytes + header.name, header.name_len);
+      out.append(1, ':');
+      out.append(_bytes + header.value, header.value_len);
+      out.append(1, '\n');
     } // for
-    return ret.str();
-  } // StompHeaders::headers
+    return out.length() - len;
+  } // StompHeaders::append_headers
 
  std::ostream &operator<<(std::ostream &ss, const StompHeaders *headers) {
     ss << headers->headersToString();
@@ -8,6 +8,9 @@
 #include <iostream>
 #include <sstream>
 
+#include <stdio.h>
+#include <string.h>
+
 #include <ossp/uuid++.hh>
 
 #include <openframe/openframe.h>
@@ -17,51 +20,179 @@
 namespace stomp {
 
 /**************************************************************************
- ** StompFrame Class                                                     **
+ ** StompMessage Class                                                   **
  **************************************************************************/
+  StompMessage::idModeEnum StompMessage::_id_mode		= StompMessage::idModeSequence;
+  std::string StompMessage::_id_prefix;
+  uint64_t StompMessage::_id_sequence			= 0;
+
   StompMessage::StompMessage(const string &destination, const string &body, const time_t inactivity_timeout)
-               : StompFrame("MESSAGE", body),
+               : StompFrame(commandMessage, body),
                  _destination(destination),
-                 _body(body),
                  _inactivity_timeout(inactivity_timeout),
                  _created( time(NULL) ),
                  _last_activity( time(NULL) ),
                  _sent(0),
-                 _num_attempts(0) {
-    _id = create_uuid();
-    replace_header("message-id", _id );
-    replace_header("destination", destination);
+                 _num_attempts(0),
+                 _expiry_at(0),
+                 _expiry_slot(0),
+                 _expired(false),
+                 _wire_version(0),
+                 _wire_ok(false) {
+    char id[kMaxIdLength];
+    size_t id_len = create_id(id);
+    replace_header(headerMessageId, id, id_len);
+    replace_header(headerDestination, destination);
   } // StompMessage::StompMessage
 
   StompMessage::StompMessage(const string &destination, const string &transaction, const string &body, const time_t inactivity_timeout)
-               : StompFrame("MESSAGE", body),
+               : StompFrame(commandMessage, body),
+                 _destination(destination),
+                 _inactivity_timeout(inactivity_timeout),
+                 _created( time(NULL) ),
+                 _last_activity( time(NULL) ),
+                 _sent(0),
+                 _num_attempts(0),
+                 _expiry_at(0),
+                 _expiry_slot(0),
+                 _expired(false),
+                 _wire_version(0),
+                 _wire_ok(false) {
+    char id[kMaxIdLength];
+    size_t id_len = create_id(id);
+    replace_header(headerMessageId, id, id_len);
+    replace_header(headerDestination, destination);
+    replace_header(headerTransaction, transaction);
+  } // StompMessage::StompMessage
+
+  // shares the body of frame, usually a SEND, and copies its headers
+  StompMessage::StompMessage(const string &destination, StompFrame *frame, const time_t inactivity_timeout)
+               : StompFrame(commandMessage, frame->payload()),
                  _destination(destination),
-                 _transaction(transaction),
-                 _body(body),
                  _inactivity_timeout(inactivity_timeout),
                  _created( time(NULL) ),
                  _last_activity( time(NULL) ),
                  _sent(0),
-                 _num_attempts(0) {
-    _id = create_uuid();
-    replace_header("message-id", _id );
-    replace_header("destination", destination);
-    replace_header("transaction", transaction);
+                 _num_attempts(0),
+                 _expiry_at(0),
+                 _expiry_slot(0),
+                 _expired(false),
+                 _wire_version(0),
+                 _wire_ok(false) {
+    // the id is ours whatever the SEND carried, subscriptions find ACK
+    // and NACK targets by it
+    copy_headers_from(frame);
+    char id[kMaxIdLength];
+    size_t id_len = create_id(id);
+    replace_header(headerMessageId, id, id_len);
+    if ( !is_header(headerDestination) ) replace_header(headerDestination, destination);
   } // StompMessage::StompMessage
 
   StompMessage::~StompMessage() {
   } // StompMessage::~StompMessage
 
+  void StompMessage::encode() {
+    const string command = command_str(commandMessage);
+
+    _wire.clear();
+    _wire.reserve(command.length() + headers_length() + 2);
+    _wire.append(command);
+    _wire.append(1, '\n');
+
+    for(size_t i=0; i < num_headers(); i++) {
+      headerEnum known = header_known(i);
+      // both are per delivery or derived from the body, never cached
+      if (known == headerSubscription || known == headerContentLength) continue;
+      StompSlice name = header_name(i);
+      StompSlice value = header_value(i);
+      _wire.append(name.data(), name.length());
+      _wire.append(1, ':');
+      _wire.append(value.data(), value.length());
+      _wire.append(1, '\n');
+    } // for
+
+
+    _wire_version = version();
+    _wire_ok = true;
+  } // StompMessage::encode
+
+  const size_t StompMessage::compile(const string &subscription, string &out) {
+    if (!_wire_ok || _wire_version != version()) encode();
+
+    static const string content_length_str = header_str(headerContentLength);
+    static const string subscription_str = header_str(headerSubscription);
+    char content_length[24];
+    size_t content_length_len = snprintf(content_length, sizeof(content_length), "%lu", (unsigned long) _payload->length());
+
+    size_t len = _wire.length()
+                 + content_length_str.length() + content_length_len + 2
+                 + subscription_str.length() + subscription.length() + 3
+                 + _payload->length() + 2;
+    out.reserve(out.length() + len);
+    out.append(_wire);
+    out.append(content_length_str);
+    out.append(1, ':');
+    out.append(content_length, content_length_len);
+    out.append(1, '\n');
+    out.append(subscription_str);
+    out.append(1, ':');
+    out.append(subscription);
+    out.append(1, '\n');
+    out.append(1, '\n');
+    out.append(_payload->str());
+    out.append(1, '\0');
+    out.append(1, '\n');
+    return len;
+  } // StompMessage::compile
+
   const string StompMessage::toString() const {
     stringstream out;
     out << "StompMessage destination=" << _destination
-        << ",id=" << _id
-        << ",transaction=" << _transaction
-        << ",body=" << (_body.length() < 128 ? _body : _body.substr(0, 128)+"...")
+        << ",id=" << id()
+        << ",transaction=" << transaction()
+        << ",body=" << (_payload->length() < 128 ? _payload->str() : _payload->str().substr(0, 128)+"...")
         << ",inactivity_timeout=" << _inactivity_timeout;
     return out.str();
   } // StompMessage::toString
 
+  void StompMessage::set_id_prefix(const string &prefix) {
+    _id_prefix = prefix.substr(0, kMaxIdPrefixLength);
+  } // StompMessage::set_id_prefix
+
+  const size_t StompMessage::create_id(char *buf) {
+    if (_id_mode == idModeUuid) {
+      string id = create_uuid();
+      size_t len = id.length();
+      if (len > kMaxIdLength) len = kMaxIdLength;
+      memcpy(buf, id.data(), len);
+      return len;
+    } // if
+
+    // made once on first use, thread safe as a function local static
+    static const string default_prefix = create_uuid().substr(0, kMaxIdPrefixLength);
+    const string &prefix = (_id_prefix.empty() ? default_prefix : _id_prefix);
+    uint64_t sequence = __sync_fetch_and_add(&_id_sequence, 1);
+
+    // 20 digits hold any uint64_t
+    char digits[20];
+    size_t num_digits = 0;
+    do {
+      digits[num_digits++] = '0' + (sequence % 10);
+      sequence /= 10;
+    } while(sequence);
+
+    size_t len = prefix.length();
+    memcpy(buf, prefix.data(), len);
+    buf[len++] = ':';
+    while(num_digits) buf[len++] = digits[--num_digits];
+    return len;
+  } // StompMessage::create_id
+
+  const string StompMessage::create_id() {
+    char id[kMaxIdLength];
+    return string(id, create_id(id));
+  } // StompMessage::create_id
+
   const string StompMessage::create_uuid() {
     uuid id;
     id.make(UUID_MAKE_V1);
@@ -19,6 +19,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <limits.h>
 #include <time.h>
 #include <netdb.h>
@@ -31,6 +32,7 @@
 
 #include "StompMessage.h"
 #include "StompParser.h"
+#include "StompScanner.h"
 #include "Subscription.h"
 #include "Transaction.h"
 
@@ -46,8 +48,11 @@ namespace stomp {
  **************************************************************************/
 
   const time_t StompParser::kDefaultStatsInterval		= 300;
+  const size_t StompParser::kDefaultCompactSize		= 65536;
+  const size_t StompParser::kDefaultScanBlockSize	= 4096;
+  const size_t StompParser::kDefaultMaxFrameSize	= 16777216;
 
-  StompParser::StompParser() {
+  StompParser::StompParser() : _in_pos(0), _boundary(0), _boundary_scan(0), _max_frame_size(kDefaultMaxFrameSize), _discard(false) {
     _init();
     return;
   } // StompParser::StompParser
@@ -128,8 +133,8 @@ namespace stomp {
   } // StompParser::is_heart_beat_timeout
 
   const size_t StompParser::send_error(const std::string &message, const std::string &body) {
-    StompFrame *frame = new StompFrame("ERROR", body);
-    frame->add_header("message", message);
+    StompFrame *frame = new StompFrame(StompFrame::commandError, body);
+    frame->add_header(StompHeaders::headerMessage, message);
     bool ok = send_frame(frame);
     onRecoverableError(frame);
     frame->release();
@@ -137,15 +142,15 @@ namespace stomp {
   } // StompParser::send_error
 
   const size_t StompParser::disconnect_with_error(const std::string &message, const std::string &body) {
-    StompFrame *frame = new StompFrame("ERROR", body);
-    frame->add_header("message", message);
+    StompFrame *frame = new StompFrame(StompFrame::commandError, body);
+    frame->add_header(StompHeaders::headerMessage, message);
     bool ok = send_frame(frame);
     onFatalError(frame);
     frame->release();
     return ok;
   } // StompParser::disconnect_with_error
 
-  bool StompParser::commit_transaction(const std::string &key) {
+  bool StompParser::commit_transaction(const StompSlice &key) {
     Transaction *trans = find_transaction(key);
     if (trans == NULL) return false;
 
@@ -164,19 +169,46 @@ namespace stomp {
 
   const size_t StompParser::send_frame(StompFrame *frame) {
     assert(frame != NULL); // bug
-    std::string ret = frame->compile();
-    size_t len = ret.length();
+    _encoded.clear();
+    size_t len = frame->compile(_encoded);
 
     _stats.num_frames_out++;
     _stats.num_bytes_out += len;
     datapoint("num.frames.out", 1);
     datapoint("num.bytes.out", len );
-    return _write(ret);
+    return _write(_encoded);
   } // StompParser::send_frame
 
+  const size_t StompParser::send_message(StompMessage *smesg, const std::string &subscription) {
+    assert(smesg != NULL); // bug
+    _encoded.clear();
+    size_t len = smesg->compile(subscription, _encoded);
+
+    _stats.num_frames_out++;
+    _stats.num_bytes_out += len;
+    datapoint("num.frames.out", 1);
+    datapoint("num.bytes.out", len );
+    return _write(_encoded);
+  } // StompParser::send_message
+
   size_t StompParser::receive(const char *buf, const size_t len) {
     openframe::scoped_lock slock(&_in_l);
+    if (_discard) return len;
     _heart_beat.last_ping_in = openframe::Stopwatch::Now();
+
+    // staged offsets are relative to _in_pos so dropping the parsed
+    // prefix is safe at any stage
+    if (_in_pos > kDefaultCompactSize) {
+      _boundaries.erase(_boundaries.begin(), _boundaries.begin() + _boundary);
+      for(size_t i=0; i < _boundaries.size(); i++)
+        _boundaries[i] -= _in_pos;
+      _boundary = 0;
+      _boundary_scan -= _in_pos;
+
+      _in.erase(0, _in_pos);
+      _in_pos = 0;
+    } // if
+
     _in.append(buf, len);
     _stats.num_bytes_in += len;
 
@@ -200,16 +232,15 @@ namespace stomp {
 
       size_t limit = 1000;
       for(size_t i = 0; i < limit && sub->dequeue_for_send(smesg); i++) {
-        smesg->replace_header("subscription", sub->id() );
-        send_frame( dynamic_cast<StompFrame *>(smesg) );
-        if ( !smesg->requires_resp() ) smesg->release(); // if we dont need response release
+        send_message(smesg, sub->id() );
+        smesg->release();	// _sentq holds its own reference until the ACK
       } // for
     } // for
 
     try_heart_beat();
 
     openframe::scoped_lock slock(&_in_l);
-    if (_in.length() < 1) return false;
+    if (_in.length() <= _in_pos) return false;
 
     bool ret;
 
@@ -234,151 +265,262 @@ namespace stomp {
         break;
     } // switch
 
+    // still waiting on the staged frame, everything buffered belongs to it
+    if (!ret && _stage != stompStageCommand
+        && _in.length() - _in_pos > _max_frame_size) {
+      _process_invalid("frame too large");
+      return false;
+    } // if
+
 #ifdef STOMP_PARSER_DEBUG
-std::cout << _stagedFrame.command << " stage(" << _stage << ") ret(" << ret << ")" << std::endl;
+std::cout << "stage(" << _stage << ") ret(" << ret << ")" << std::endl;
 #endif
 
     return ret;
   } // StompParer::process
 
   bool StompParser::_process_command() {
-    string command;
-    command.reserve(30);
+    const char *buf = _in.data() + _in_pos;
+    const size_t len = _in.length() - _in_pos;
+
+    size_t eol;
+    bool ok = _find_boundary('\n', _stagedFrame.scan, eol);
+    if (!ok) {
+      _stagedFrame.scan = len;
+      return false;
+    } // if
 
-    bool ok = _in.sfind('\n', command);
-    if (!ok) return false;
+    size_t command_len = eol;
+    if (command_len && buf[command_len - 1] == '\r') command_len--;
 
 #ifdef STOMP_PARSER_DEBUG
-std::cout << "COMMAND(" << command << ")" << std::endl;
+std::cout << "COMMAND(" << string(buf, command_len) << ")" << std::endl;
 #endif
 
-    StringTool::replace("\r", "", command);
-
-    if (command.length() == 0) {
+    if (command_len == 0) {
+      // heart-beat or the trailing newline of the previous frame
+      _consume(eol + 1);
       _process_reset();
-      return true;		// in case this is the end of a frame
+      return true;
     } // if
 
-    _stagedFrame.command = command;
+    _stagedFrame.command_len = command_len;
+    _stagedFrame.line = _stagedFrame.scan = eol + 1;
     _stage = stompStageHeaders;
     return true;
   } // StompParser::process_command
 
   bool StompParser::_process_headers() {
-    StompHeader *header;
-    string header_str;
+    const char *buf = _in.data() + _in_pos;
+    const size_t len = _in.length() - _in_pos;
 
     size_t num_headers = 0;
     while(1) {
-//std::cout << "MEH(" << _in.substr(_in_pos) << ")" << std::endl;
-      bool ok = _in.sfind('\n', header_str);
-      if (!ok) return (num_headers ? true : false);
+      size_t eol;
+      bool ok = _find_boundary('\n', _stagedFrame.scan, eol);
+      if (!ok) {
+        _stagedFrame.scan = len;
+        return (num_headers ? true : false);
+      } // if
 
       num_headers++;
 
+      size_t line = _stagedFrame.line;
+      size_t line_end = eol;
+      if (line_end > line && buf[line_end - 1] == '\r') line_end--;
+
 #ifdef STOMP_PARSER_DEBUG
-std::cout << "LEN(" << len << ") HEADER(" << header_str << ")" << std::endl;
+std::cout << "HEADER(" << string(buf + line, line_end - line) << ")" << std::endl;
 #endif
 
-//      ret += header_str.length();
-      StringTool::replace("\r", "", header_str);
-      if (header_str.length() == 0) {
-        stompHeader_itr itr = _stagedFrame.headers.find("Content-Length");
-        if (itr != _stagedFrame.headers.end()) {
-          _stagedFrame.content_length = atoi( itr->second->value().c_str() );
-          _stage = stompStageBodyLen;
-        } // if
-        else
-          _stage = stompStageBodyNul;
+      _stagedFrame.line = _stagedFrame.scan = eol + 1;
+
+      if (line_end == line) {
+        _stagedFrame.body = eol + 1;
+        _stage = (_stagedFrame.has_content_length ? stompStageBodyLen : stompStageBodyNul);
         break;
       } // if
 
-      try {
-        header = new StompHeader(header_str);
-      } // try
-      catch(Stomp_Exception &ex) {
+      const char *colon = (const char *) memchr(buf + line, ':', line_end - line);
+      if (colon == NULL) {
         // unable to parse header send error
         send_error("unable to parse header");
+        _consume(eol + 1);
         _process_reset();
         break;
-      } //catch
-
-      if (_stagedFrame.headers.find(header->name()) != _stagedFrame.headers.end()) {
-        // stomp 1.1 spec says only the first header of the same name is accepted
-        header->release();
-        continue;
       } // if
 
-      _stagedFrame.headers.insert( make_pair(header->name(), header) );
+      stompHeaderSlice_t header;
+      header.name = line;
+      header.name_len = (colon - buf) - line;
+      header.value = header.name + header.name_len + 1;
+      header.value_len = line_end - header.value;
+
+      // trim the value like StompHeader does
+      while(header.value_len && isspace( (unsigned char) buf[header.value] )) {
+        header.value++;
+        header.value_len--;
+      } // while
+      while(header.value_len && isspace( (unsigned char) buf[header.value + header.value_len - 1] ))
+        header.value_len--;
+
+      header.known = StompHeaders::classify(buf + header.name, header.name_len);
+
+      if (!_stagedFrame.has_content_length
+          && header.known == StompHeaders::headerContentLength) {
+        size_t content_length;
+        bool ok = StompSlice(buf + header.value, header.value_len).to_size(content_length);
+        if (!ok || content_length > _max_frame_size) {
+          // the body can't be found without it, there is no resyncing
+          _process_invalid("invalid content-length");
+          return false;
+        } // if
+        _stagedFrame.content_length = content_length;
+        _stagedFrame.has_content_length = true;
+      } // if
 
+      // stomp 1.1 spec says only the first header of the same name is accepted,
+      // add_header() drops the duplicates when the frame is built
+      _stagedFrame.headers.push_back(header);
     } // while
 
     return true;
   } // StompParser::_process_headers
 
   bool StompParser::_process_body_len() {
-    size_t ret = 0;
+    const size_t len = _in.length() - _in_pos;
+    if (len - _stagedFrame.body < _stagedFrame.content_length) return false;
 
-    bool ok = _in.next_bytes(_stagedFrame.content_length, _stagedFrame.body);
-    if (!ok) return false;
-
-    ret = _stagedFrame.body.length();
+    _stagedFrame.scan = _stagedFrame.body + _stagedFrame.content_length;
     _stage = stompStageWaitForNul;
 
     return true;
   } // StompParser::_process_body_len
 
   bool StompParser::_process_waitfor_nul() {
-    std::string ret;
-    bool ok = _in.sfind('\0', ret);
-    if (!ok) return false;
+    const size_t len = _in.length() - _in_pos;
 
-    StompFrame *frame = new StompFrame(_stagedFrame.command, _stagedFrame.body);
-    frame->insert(_stagedFrame.headers.begin(), _stagedFrame.headers.end());
-    _stagedFrame.headers.clear();
+    size_t nul;
+    bool ok = _find_boundary('\0', _stagedFrame.scan, nul);
+    if (!ok) {
+      _stagedFrame.scan = len;
+      return false;
+    } // if
 
-    _frameQ.push(frame);
-    _stats.num_frames_in++;
-    datapoint("num.frames.in", 1);
-    _process_reset();
+    _process_frame(_stagedFrame.content_length, nul + 1);
 
     return true;
   } // StompParser::_process_waitfor_nul
 
   bool StompParser::_process_body_nul() {
-    bool ok = _in.sfind('\0', _stagedFrame.body);
-    if (!ok) return false;
-//std::cout << "LEN(" << len << ") POS(" << _in_pos << ") _IN(" << _in.length() << ")" << std::endl;
+    const size_t len = _in.length() - _in_pos;
+
+    size_t scan = (_stagedFrame.scan > _stagedFrame.body ? _stagedFrame.scan : _stagedFrame.body);
+    size_t nul;
+    bool ok = _find_boundary('\0', scan, nul);
+    if (!ok) {
+      _stagedFrame.scan = len;
+      return false;
+    } // if
+
+    size_t body_len = nul - _stagedFrame.body;
 
 #ifdef STOMP_PARSER_DEBUG
-std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
+std::cout << "BODY(" << _in.substr(_in_pos + _stagedFrame.body, body_len) << ")" << std::endl;
 #endif
 
-    StompFrame *frame = new StompFrame(_stagedFrame.command, _stagedFrame.body);
-    frame->insert(_stagedFrame.headers.begin(), _stagedFrame.headers.end());
-    _stagedFrame.headers.clear();
+    _process_frame(body_len, nul + 1);
 
-    _frameQ.push(frame);
+    return true;
+  } // StompParser::_process_body_nul
+
+  void StompParser::_process_frame(const size_t body_len, const size_t frame_len) {
+    const char *buf = _in.data() + _in_pos;
+
+    StompFrame *frame;
+    StompFrame::commandEnum type = StompFrame::classify(buf, _stagedFrame.command_len);
+    if (type == StompFrame::commandUnknown)
+      frame = new StompFrame(string(buf, _stagedFrame.command_len),
+                             string(buf + _stagedFrame.body, body_len));
+    else
+      frame = new StompFrame(type, buf + _stagedFrame.body, body_len);
+
+    for(size_t i=0; i < _stagedFrame.headers.size(); i++) {
+      const stompHeaderSlice_t &header = _stagedFrame.headers[i];
+      frame->add_header(header.known,
+                        buf + header.name, header.name_len,
+                        buf + header.value, header.value_len);
+    } // for
 
+    _frameQ.push(frame);
     _stats.num_frames_in++;
     datapoint("num.frames.in", 1);
+
+    _consume(frame_len);
     _process_reset();
+  } // StompParser::_process_frame
+
+  void StompParser::_consume(const size_t len) {
+    _in_pos += len;
+    assert(_in_pos <= _in.length());	// bug
+
+    if (_in_pos == _in.length()) {
+      // keep capacity, no need to shift anything
+      _in.clear();
+      _in_pos = 0;
+      _boundaries.clear();
+      _boundary = 0;
+      _boundary_scan = 0;
+    } // if
+  } // StompParser::_consume
 
-    return true;
-  } // StompParser::_process_body_nul
+  bool StompParser::_find_boundary(const char c, const size_t from, size_t &ret) {
+    const size_t start = _in_pos + from;
 
-  void StompParser::_process_reset() {
-    _stagedFrame.command = "";
-    _stagedFrame.body = "";
-    _stagedFrame.content_length = 0;
+    // nothing before start matters, don't sweep it
+    if (_boundary_scan < start) _boundary_scan = start;
+
+    while(1) {
+      for(; _boundary < _boundaries.size(); _boundary++) {
+        size_t pos = _boundaries[_boundary];
+        if (pos < start || _in[pos] != c) continue;
+        _boundary++;
+        ret = pos - _in_pos;
+        return true;
+      } // for
 
-    for(stompHeader_itr itr = _stagedFrame.headers.begin(); itr != _stagedFrame.headers.end(); itr++)
-      itr->second->release();
+      if (_boundary_scan >= _in.length()) return false;
 
+      _boundaries.clear();
+      _boundary = 0;
+
+      size_t len = _in.length() - _boundary_scan;
+      if (len > kDefaultScanBlockSize) len = kDefaultScanBlockSize;
+      StompScanner::scan(_in.data() + _boundary_scan, len, _boundary_scan, _boundaries);
+      _boundary_scan += len;
+    } // while
+  } // StompParser::_find_boundary
+
+  void StompParser::_process_reset() {
+    _stagedFrame.line = 0;
+    _stagedFrame.scan = 0;
+    _stagedFrame.command_len = 0;
+    _stagedFrame.body = 0;
+    _stagedFrame.content_length = 0;
+    _stagedFrame.has_content_length = false;
     _stagedFrame.headers.clear();
     _stage = stompStageCommand;
   } // StompParser::_process_reset
 
+  // a frame we can't find the end of, drop the peer and everything it
+  // sends from here on
+  void StompParser::_process_invalid(const std::string &reason) {
+    disconnect_with_error(reason);
+    _discard = true;
+    _consume(_in.length() - _in_pos);
+    _process_reset();
+  } // StompParser::_process_invalid
+
   const string::size_type StompParser::_write(const string &buf) {
     openframe::scoped_lock slock(&_out_l);
     _heart_beat.last_ping_out = openframe::Stopwatch::Now();
@@ -388,8 +530,11 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
 
   const string::size_type StompParser::transmit(string &ret) {
     openframe::scoped_lock slock(&_out_l);
-    ret = _out;
-    _out = "";
+    // hand over the buffer without copying it, _out takes the caller's
+    // string in exchange so a caller reusing one string ping-pongs two
+    // allocations instead of growing a new one each time
+    ret.swap(_out);
+    _out.clear();
     return ret.size();
   } // StompParser::transmit
 
@@ -401,6 +546,11 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
     openframe::scoped_lock sl_out(&_out_l);
     openframe::scoped_lock sl_in(&_in_l);
     _in = _out = "";
+    _in_pos = 0;
+    _boundaries.clear();
+    _boundary = 0;
+    _boundary_scan = 0;
+    _discard = false;
     _process_reset();
   } // StompParser::reset
 
@@ -408,15 +558,15 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
    ** Commands                                                             **
    **************************************************************************/
   bool StompParser::connect(const std::string &username, const std::string &passcode, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("CONNECT");
+    StompFrame *frame = new StompFrame(StompFrame::commandConnect);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
     if (username.length()) {
-      frame->replace_header("login", username);
-      frame->replace_header("passcode", passcode);
+      frame->replace_header(StompHeaders::headerLogin, username);
+      frame->replace_header(StompHeaders::headerPasscode, passcode);
     } // if
 
     size_t ret = send_frame(frame);
@@ -426,13 +576,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::connect
 
   bool StompParser::connected(const string &session_id, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("CONNECTED");
+    StompFrame *frame = new StompFrame(StompFrame::commandConnected);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("session", session_id);
+    frame->replace_header(StompHeaders::headerSession, session_id);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -440,13 +590,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::connected
 
   bool StompParser::send(const std::string &destination, const std::string &body, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("SEND", body);
+    StompFrame *frame = new StompFrame(StompFrame::commandSend, body);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("destination", destination);
+    frame->replace_header(StompHeaders::headerDestination, destination);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -455,14 +605,14 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
 
   bool StompParser::subscribe(const std::string &destination, const std::string &subscription,
                               StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("SUBSCRIBE");
+    StompFrame *frame = new StompFrame(StompFrame::commandSubscribe);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("destination", destination);
-    frame->replace_header("id", subscription);
+    frame->replace_header(StompHeaders::headerDestination, destination);
+    frame->replace_header(StompHeaders::headerId, subscription);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -470,13 +620,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::subscribe
 
   bool StompParser::unsubscribe(const string &destination, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("UNSUBSCRIBE");
+    StompFrame *frame = new StompFrame(StompFrame::commandUnsubscribe);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("destination", destination);
+    frame->replace_header(StompHeaders::headerDestination, destination);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -484,13 +634,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::unsubscribe
 
   bool StompParser::begin(const std::string &transaction, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("BEGIN");
+    StompFrame *frame = new StompFrame(StompFrame::commandBegin);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("transaction", transaction);
+    frame->replace_header(StompHeaders::headerTransaction, transaction);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -498,13 +648,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::begin
 
   bool StompParser::commit(const std::string &transaction, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("COMMIT");
+    StompFrame *frame = new StompFrame(StompFrame::commandCommit);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("transaction", transaction);
+    frame->replace_header(StompHeaders::headerTransaction, transaction);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -512,14 +662,14 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::commit
 
   bool StompParser::ack(const std::string &message_id, const std::string &subscription, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("ACK");
+    StompFrame *frame = new StompFrame(StompFrame::commandAck);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("message-id", message_id);
-    frame->replace_header("subscription", subscription);
+    frame->replace_header(StompHeaders::headerMessageId, message_id);
+    frame->replace_header(StompHeaders::headerSubscription, subscription);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -527,14 +677,14 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::ack
 
   bool StompParser::nack(const std::string &message_id, const std::string &subscription, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("NACK");
+    StompFrame *frame = new StompFrame(StompFrame::commandNack);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("message-id", message_id);
-    frame->replace_header("subscription", subscription);
+    frame->replace_header(StompHeaders::headerMessageId, message_id);
+    frame->replace_header(StompHeaders::headerSubscription, subscription);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -542,13 +692,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
   } // StompParser::nack
 
   bool StompParser::abort(const string &transaction, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("ABORT");
+    StompFrame *frame = new StompFrame(StompFrame::commandAbort);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("transaction", transaction);
+    frame->replace_header(StompHeaders::headerTransaction, transaction);
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -557,28 +707,28 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
 
   bool StompParser::message(const std::string &destination, const std::string &message_id,
                             const std::string &body, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("MESSAGE", body);
+    StompFrame *frame = new StompFrame(StompFrame::commandMessage, body);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("destination", destination)
-          .replace_header("message-id", message_id);
+    frame->replace_header(StompHeaders::headerDestination, destination)
+          .replace_header(StompHeaders::headerMessageId, message_id);
     size_t ret = send_frame(frame);
     frame->release();
 
     return ret > 0 ? true : false;
   } // StompParser::message
 
-  bool StompParser::receipt(const std::string &receipt_id, StompHeaders *headers) {
-    StompFrame *frame = new StompFrame("RECEIPT");
+  bool StompParser::receipt(const StompSlice &receipt_id, StompHeaders *headers) {
+    StompFrame *frame = new StompFrame(StompFrame::commandReceipt);
     if (headers) {
       frame->copy_headers_from(headers);
       headers->release();
     } // if
 
-    frame->replace_header("receipt-id", receipt_id);
+    frame->replace_header(StompHeaders::headerReceiptId, receipt_id.data(), receipt_id.length());
     size_t ret = send_frame(frame);
     frame->release();
 
@@ -659,13 +809,13 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
     return true;
   } // StompParser::forget_subscription
 
-  Subscription *StompParser::find_subscription(const std::string &id) {
+  Subscription *StompParser::find_subscription(const StompSlice &id) {
     subscriptions_itr itr = _subscriptions.find(id);
     if (itr == _subscriptions.end()) return NULL;
-    return _subscriptions[id];
+    return itr->second;
   } // StompParser::find_subscription
 
-  const bool StompParser::received_ack(const string &id, const string &message_id) {
+  const bool StompParser::received_ack(const StompSlice &id, const StompSlice &message_id) {
     for(binds_itr itr = _binds.begin(); itr != _binds.end(); itr++) {
       Subscription *sub = *itr;
       if ( sub->is_id(id) ) return sub->dequeue(message_id);
@@ -673,7 +823,7 @@ std::cout << "BODY(" << _stagedFrame.body << ")" << std::endl;
     return false;
   } // StompParser::received_ack
 
-  const bool StompParser::received_nack(const string &id, const string &message_id) {
+  const bool StompParser::received_nack(const StompSlice &id, const StompSlice &message_id) {
     for(binds_itr itr = _binds.begin(); itr != _binds.end(); itr++) {
       Subscription *sub = *itr;
       if ( sub->is_id(id) ) return sub->redeliver(message_id);
@@ -0,0 +1,35 @@
+#include "config.h"
+
+#include <string>
+#include <cassert>
+
+#include <openframe/openframe.h>
+
+#include "StompPayload.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** StompPayload Class                                                   **
+ **************************************************************************/
+  StompPayload::StompPayload(const std::string &data) : _data(data) {
+  } // StompPayload::StompPayload
+
+  StompPayload::StompPayload(const char *data, const size_t len) : _data(data, len) {
+  } // StompPayload::StompPayload
+
+  StompPayload::~StompPayload() {
+  } // StompPayload::~StompPayload
+
+  StompPayload *StompPayload::empty() {
+    // never released below one so it outlives every frame
+    static StompPayload *payload = new StompPayload( std::string() );
+    payload->retain();
+    return payload;
+  } // StompPayload::empty
+
+  StompPayload *StompPayload::create(const char *data, const size_t len) {
+    if (len == 0) return empty();
+    return new StompPayload(data, len);
+  } // StompPayload::create
+} // namespace stomp
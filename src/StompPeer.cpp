@@ -158,12 +158,12 @@ namespace stomp {
 
   void StompPeer::onRecoverableError(StompFrame *frame) {
     LOG(LogInfo, << "StompPeer error "
-                 << frame->get_header("message") << " to " << this << std::endl);
+                 << frame->get_header(StompHeaders::headerMessage) << " to " << this << std::endl);
   } // StompPeer::onRecoverableError
 
   void StompPeer::onFatalError(StompFrame *frame) {
     LOG(LogInfo, << "StompPeer fatal error "
-                 << frame->get_header("message") << " to " << this << std::endl);
+                 << frame->get_header(StompHeaders::headerMessage) << " to " << this << std::endl);
     wantDisconnect();
   } // StompPeer::onFatalError
 
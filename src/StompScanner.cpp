@@ -0,0 +1,109 @@
+#include "config.h"
+
+#include <string>
+#include <vector>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STOMP_SCANNER_X86
+#endif
+
+#include "StompScanner.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** StompScanner Class                                                   **
+ **************************************************************************/
+  StompScanner::scanFunc_t StompScanner::_scan = NULL;
+
+  StompScanner::boundaries_st StompScanner::scan(const char *buf, const size_t len,
+                                                  const size_t base, boundaries_t &ret) {
+    if (_scan == NULL) _scan = select();
+    return _scan(buf, len, base, ret);
+  } // StompScanner::scan
+
+  StompScanner::scanFunc_t StompScanner::select() {
+#ifdef STOMP_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &scan_avx2;
+    if (__builtin_cpu_supports("sse2")) return &scan_sse2;
+#endif
+    return &scan_bytes;
+  } // StompScanner::select
+
+  const std::string StompScanner::isa() {
+    if (_scan == NULL) _scan = select();
+    if (_scan == &scan_avx2) return "avx2";
+    if (_scan == &scan_sse2) return "sse2";
+    return "bytes";
+  } // StompScanner::isa
+
+  StompScanner::boundaries_st StompScanner::scan_bytes(const char *buf, const size_t len,
+                                                        const size_t base, boundaries_t &ret) {
+    boundaries_st num = 0;
+    for(size_t i=0; i < len; i++) {
+      if (buf[i] != '\n' && buf[i] != '\0') continue;
+      ret.push_back(base + i);
+      num++;
+    } // for
+    return num;
+  } // StompScanner::scan_bytes
+
+#ifdef STOMP_SCANNER_X86
+  __attribute__((target("sse2")))
+  StompScanner::boundaries_st StompScanner::scan_sse2(const char *buf, const size_t len,
+                                                       const size_t base, boundaries_t &ret) {
+    boundaries_st num = 0;
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i nul = _mm_setzero_si128();
+
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16) {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (buf + i));
+      unsigned int mask = _mm_movemask_epi8( _mm_or_si128(_mm_cmpeq_epi8(chunk, nl),
+                                                          _mm_cmpeq_epi8(chunk, nul)) );
+      while(mask) {
+        ret.push_back(base + i + __builtin_ctz(mask));
+        mask &= mask - 1;
+        num++;
+      } // while
+    } // for
+
+    return num + scan_bytes(buf + i, len - i, base + i, ret);
+  } // StompScanner::scan_sse2
+
+  __attribute__((target("avx2")))
+  StompScanner::boundaries_st StompScanner::scan_avx2(const char *buf, const size_t len,
+                                                       const size_t base, boundaries_t &ret) {
+    boundaries_st num = 0;
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i nul = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *) (buf + i));
+      unsigned int mask = _mm256_movemask_epi8( _mm256_or_si256(_mm256_cmpeq_epi8(chunk, nl),
+                                                                _mm256_cmpeq_epi8(chunk, nul)) );
+      while(mask) {
+        ret.push_back(base + i + __builtin_ctz(mask));
+        mask &= mask - 1;
+        num++;
+      } // while
+    } // for
+
+    return num + scan_sse2(buf + i, len - i, base + i, ret);
+  } // StompScanner::scan_avx2
+#else
+  StompScanner::boundaries_st StompScanner::scan_sse2(const char *buf, const size_t len,
+                                                       const size_t base, boundaries_t &ret) {
+    return scan_bytes(buf, len, base, ret);
+  } // StompScanner::scan_sse2
+
+  StompScanner::boundaries_st StompScanner::scan_avx2(const char *buf, const size_t len,
+                                                       const size_t base, boundaries_t &ret) {
+    return scan_bytes(buf, len, base, ret);
+  } // StompScanner::scan_avx2
+#endif
+} // namespace stomp
@@ -41,7 +41,10 @@ namespace stomp {
                 _intval_logstats(kDefaultLogstatsInterval),
                 _time_queue_expire(kDefaultQueueMessageExpire),
                 _max_work(kDefaultMaxWork),
-                _queue_byte_limit(Exchange::kDefaultByteLimit) {
+                _queue_byte_limit(Exchange::kDefaultByteLimit),
+                _sub_max_bytes(0),
+                _sub_max_messages(0),
+                _sub_overflow_policy(Subscription::overflowDropOldest) {
 
     init_stats(true);
     _exch_manager = new ExchangeManager;
@@ -122,6 +125,17 @@ namespace stomp {
     return *this;
   } // StompServer::start
 
+  StompServer &StompServer::set_dispatch_budget(const double budget) {
+    _exch_manager->set_dispatch_budget(budget);
+    return *this;
+  } // StompServer::set_dispatch_budget
+
+  // key as the exchange knows it, e.g. "queue/orders"
+  StompServer &StompServer::set_exchange_weight(const std::string &key, const size_t weight) {
+    _exch_manager->set_weight(key, weight);
+    return *this;
+  } // StompServer::set_exchange_weight
+
   bool StompServer::_process_peers(peers_t &peers) {
     int didWork = 0;
 
@@ -234,9 +248,10 @@ namespace stomp {
     } // switch
 
     if (!frame->is_command(StompFrame::commandConnect)
-        && frame->is_header("receipt")) {
-      StompFrame *receipt_frame = new StompFrame("RECEIPT");
-      receipt_frame->add_header("receipt-id", frame->get_header("receipt"));
+        && frame->is_header(StompHeaders::headerReceipt)) {
+      StompFrame *receipt_frame = new StompFrame(StompFrame::commandReceipt);
+      StompSlice receipt = frame->header(StompHeaders::headerReceipt);
+      receipt_frame->replace_header(StompHeaders::headerReceiptId, receipt.data(), receipt.length());
       peer->send_frame(receipt_frame);
       receipt_frame->release();
     } // if
@@ -245,18 +260,18 @@ namespace stomp {
   } // StompServer::process
 
   void StompServer::_process_connect(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("login")) {
+    if (!frame->is_header(StompHeaders::headerLogin)) {
       peer->disconnect_with_error("missing login");
       return;
     } // if
 
-    if (!frame->is_header("passcode")) {
+    if (!frame->is_header(StompHeaders::headerPasscode)) {
       peer->disconnect_with_error("missing passcode");
       return;
     } // if
 
-    std::string login = frame->get_header("login");
-    std::string passcode = frame->get_header("passcode");
+    std::string login = frame->get_header(StompHeaders::headerLogin);
+    std::string passcode = frame->get_header(StompHeaders::headerPasscode);
 
     if (!login.length()) {
       peer->disconnect_with_error("must specify login");
@@ -276,10 +291,10 @@ namespace stomp {
     time_t i_will = 0;
     time_t i_support = 0;
     time_t i_expect = 0;
-    if (frame->is_header("heart-beat")) {
+    if (frame->is_header(StompHeaders::headerHeartBeat)) {
       openframe::StringToken st;
       st.setDelimiter(',');
-      st = frame->get_header("heart-beat");
+      st = frame->get_header(StompHeaders::headerHeartBeat);
 
       if (st.size() != 2) {
         peer->disconnect_with_error("unable to parse heart-beat header must be <cx>,<cy>");
@@ -302,27 +317,25 @@ namespace stomp {
                  << i_support << "," << i_expect
                  << " for " << peer << std::endl);
 
-    peer->connected(StompMessage::create_uuid(), new StompHeaders("heart-beat", s.str() ));
+    peer->connected(StompMessage::create_id(), new StompHeaders("heart-beat", s.str() ));
   } // StompServer::_process_connect
 
   void StompServer::_process_begin(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("transaction")) {
+    if (!frame->is_header(StompHeaders::headerTransaction)) {
       peer->send_error("missing transaction header");
       return;
     } // if
 
-    std::string transaction_id = frame->get_header("transaction");
-    peer->create_transaction(transaction_id);
+    peer->create_transaction( frame->header(StompHeaders::headerTransaction) );
   } // StompServer::_process_begin
 
   void StompServer::_process_commit(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("transaction")) {
+    if (!frame->is_header(StompHeaders::headerTransaction)) {
       peer->send_error("missing transaction header");
       return;
     } // if
 
-    std::string transaction_id = frame->get_header("transaction");
-    bool ok = peer->commit_transaction(transaction_id);
+    bool ok = peer->commit_transaction( frame->header(StompHeaders::headerTransaction) );
     if (!ok) {
       peer->send_error("transaction not found");
       return;
@@ -330,13 +343,12 @@ namespace stomp {
   } // StompServer::_process_commit
 
   void StompServer::_process_abort(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("transaction")) {
+    if (!frame->is_header(StompHeaders::headerTransaction)) {
       peer->send_error("missing transaction header");
       return;
     } // if
 
-    std::string transaction_id = frame->get_header("transaction");
-    bool ok = peer->destroy_transaction(transaction_id);
+    bool ok = peer->destroy_transaction( frame->header(StompHeaders::headerTransaction) );
 
     if (!ok) {
       peer->send_error("transaction not found");
@@ -345,35 +357,35 @@ namespace stomp {
   } // StompServer::_process_abort
 
   void StompServer::_process_ack(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("message-id")) {
+    if (!frame->is_header(StompHeaders::headerMessageId)) {
       peer->send_error("ack missing message-id");
       return;
     } // if
 
-    if (!frame->is_header("subscription")) {
+    if (!frame->is_header(StompHeaders::headerSubscription)) {
       peer->send_error("ack missing subscription");
       return;
     } // if
 
-    std::string message_id = frame->get_header("message-id");
-    std::string subscription = frame->get_header("subscription");
+    StompSlice message_id = frame->header(StompHeaders::headerMessageId);
+    StompSlice subscription = frame->header(StompHeaders::headerSubscription);
 
     peer->received_ack(subscription, message_id);
   } // StompServer::_process_ack
 
   void StompServer::_process_nack(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("message-id")) {
+    if (!frame->is_header(StompHeaders::headerMessageId)) {
       peer->send_error("ack missing message-id");
       return;
     } // if
 
-    if (!frame->is_header("subscription")) {
+    if (!frame->is_header(StompHeaders::headerSubscription)) {
       peer->send_error("ack missing subscription");
       return;
     } // if
 
-    std::string message_id = frame->get_header("message-id");
-    std::string subscription = frame->get_header("subscription");
+    StompSlice message_id = frame->header(StompHeaders::headerMessageId);
+    StompSlice subscription = frame->header(StompHeaders::headerSubscription);
 
     peer->received_nack(subscription, message_id);
   } // StompServer::_process_nack
@@ -381,12 +393,11 @@ namespace stomp {
   bool StompServer::_store_transaction(StompPeer *peer, StompFrame *frame) {
     bool is_intercept_trans = (frame->is_command(StompFrame::commandAck) || frame->is_command(StompFrame::commandSend)
                               || frame->is_command(StompFrame::commandNack))
-                              && frame->is_header("transaction")
+                              && frame->is_header(StompHeaders::headerTransaction)
                               && !frame->execute_transaction();
     if (!is_intercept_trans) return false;
 
-    std::string transaction_id = frame->get_header("transaction");
-    Transaction *trans = peer->find_transaction(transaction_id);
+    Transaction *trans = peer->find_transaction( frame->header(StompHeaders::headerTransaction) );
     if (trans == NULL) {
       peer->send_error("transaction not found");
 
@@ -402,15 +413,15 @@ namespace stomp {
   } // StompServer::_store_transaction
 
   void StompServer::_process_send(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("destination")) {
+    if (!frame->is_header(StompHeaders::headerDestination)) {
       peer->send_error("send missing destination");
       return;
     } // if
 
     openframe::StringToken st;
     st.setDelimiter('/');
-    std::string destination = frame->get_header("destination");
-    st = destination;
+    // the tokens own their copy of it
+    st = frame->header(StompHeaders::headerDestination).str();
 
     if (st.size() < 2) {
       peer->send_error("destination invalid");
@@ -421,8 +432,7 @@ namespace stomp {
 
     if (st[0] == "topic") {
       Exchange *exch = _exch_manager->create_exchange(key, Exchange::exchangeTypeTopic);
-      StompMessage *smesg = new StompMessage( st.trail(0), frame->body());
-      smesg->copy_headers_from(frame);	 // copy headers
+      StompMessage *smesg = new StompMessage( st.trail(0), frame);	// shares the body, copies headers
 //smesg->dont_delete();
       exch->post(smesg);	// post retains
       smesg->release();
@@ -430,38 +440,49 @@ namespace stomp {
     else if (st[0] == "queue") {
       Exchange *exch = _exch_manager->create_exchange(key, Exchange::exchangeTypeFanout);
       exch->set_byte_limit(_queue_byte_limit);
-      StompMessage *smesg = new StompMessage( st.trail(0), frame->body(), _time_queue_expire);
-      smesg->copy_headers_from(frame);	// copy headers
+      StompMessage *smesg = new StompMessage( st.trail(0), frame, _time_queue_expire);	// shares the body, copies headers
 //smesg->dont_delete();
       exch->post(smesg);	// post retains
       smesg->release();
     } // else if
+    else if (st[0] == "direct") {
+      Exchange *exch = _exch_manager->create_exchange(key, Exchange::exchangeTypeDirect);
+      StompMessage *smesg = new StompMessage( st.trail(0), frame);	// shares the body, copies headers
+      exch->post(smesg);	// post retains
+      smesg->release();
+    } // else if
+    else if (st[0] == "headers") {
+      Exchange *exch = _exch_manager->create_exchange(key, Exchange::exchangeTypeHeaders);
+      StompMessage *smesg = new StompMessage( st.trail(0), frame);	// shares the body, copies headers
+      exch->post(smesg);	// post retains
+      smesg->release();
+    } // else if
     else {
-      peer->send_error("destination must be a topic or queue");
+      peer->send_error("destination must be a topic, queue, direct or headers");
       return;
     } // else
   } // StompServer::_process_send
 
   void StompServer::_process_subscribe(StompPeer *peer, StompFrame *frame) {
     stompHeader_t headers;
-    if (!frame->is_header("destination")) {
+    if (!frame->is_header(StompHeaders::headerDestination)) {
       peer->send_error("subscribe missing destination");
       return;
     } // if
 
-    if (!frame->is_header("id")) {
+    if (!frame->is_header(StompHeaders::headerId)) {
       peer->send_error("required id field missing");
       return;
     } // if
 
     Subscription::ackModeEnum ack = Subscription::ackModeAuto;
-    if (frame->is_header("ack")) {
-      std::string ack = frame->get_header("ack");
-      if (ack == "client")
+    if (frame->is_header(StompHeaders::headerAck)) {
+      StompSlice ack_str = frame->header(StompHeaders::headerAck);
+      if (ack_str.is("client"))
         ack = Subscription::ackModeClient;
-      else if (ack == "client-individual")
+      else if (ack_str.is("client-individual"))
         ack = Subscription::ackModeClientIndv;
-      else if (ack == "auto")
+      else if (ack_str.is("auto"))
         ack = Subscription::ackModeAuto;
       else {
         peer->send_error("ack must be auto or client");
@@ -474,18 +495,46 @@ namespace stomp {
       prefetch = atoi( frame->get_header("openstomp.prefetch").c_str() );
     } // if
 
+    size_t max_bytes;
+    if (!_client_limit(frame, "openstomp.max-bytes", _sub_max_bytes, max_bytes)) {
+      peer->send_error("max-bytes must be a number");
+      return;
+    } // if
+
+    size_t max_messages;
+    if (!_client_limit(frame, "openstomp.max-messages", _sub_max_messages, max_messages)) {
+      peer->send_error("max-messages must be a number");
+      return;
+    } // if
+
+    Subscription::overflowPolicyEnum overflow = _sub_overflow_policy;
+    if (frame->is_header("openstomp.overflow")) {
+      std::string overflow_str = frame->get_header("openstomp.overflow");
+      if (overflow_str == "drop-oldest")
+        overflow = Subscription::overflowDropOldest;
+      else if (overflow_str == "drop-newest")
+        overflow = Subscription::overflowDropNewest;
+      else if (overflow_str == "disconnect")
+        overflow = Subscription::overflowDisconnect;
+      else if (overflow_str == "spill")
+        overflow = Subscription::overflowSpill;
+      else {
+        peer->send_error("overflow must be drop-oldest, drop-newest, disconnect or spill");
+        return;
+      } // else
+    } // if
+
     openframe::StringToken st;
     st.setDelimiter('/');
-    std::string destination = frame->get_header("destination");
-    st = destination;
+    st = frame->header(StompHeaders::headerDestination).str();
 
     if (st.size() < 2) {
       peer->send_error("destination invalid");
       return;
     } // if
 
-    std::string id = frame->get_header("id");
-    if (id.length() < 1) {
+    StompSlice id = frame->header(StompHeaders::headerId);
+    if (id.empty()) {
       peer->send_error("invalid subscription id");
       return;
     } // if
@@ -496,35 +545,87 @@ namespace stomp {
       return;
     } // if
 
-    if (st[0] == "topic") {
-      Subscription *sub = new Subscription(peer, id, st.trail(0), ack);
-      sub->elogger( elogger(), elog_name() );
-      if (prefetch) sub->prefetch(prefetch);
-      _exch_manager->subscribe(sub);
-      sub->release();
-      //peer->subscribe(peer, id, st.trail(0), ack);
+    bool is_headers = (st[0] == "headers");
+    if (st[0] != "topic" && st[0] != "queue" && st[0] != "direct" && !is_headers) {
+      peer->send_error("destination must be a topic, queue, direct or headers");
+      return;
     } // if
-    else if (st[0] == "queue") {
-      Subscription *sub = new Subscription(peer, id, st.trail(0), ack);
-      sub->elogger( elogger(), elog_name() );
-      if (prefetch) sub->prefetch(prefetch);
-      _exch_manager->subscribe(sub);
-      sub->release();
-    } // else if
-    else {
-      peer->send_error("destination must be a topic or queue");
+
+    // only a queue can hold messages back for one sub, a shared topic,
+    // direct or headers exchange would stall everyone else on it
+    if (overflow == Subscription::overflowSpill && st[0] != "queue") {
+      if (frame->is_header("openstomp.overflow")) {
+        peer->send_error("overflow spill is only supported on queues");
+        return;
+      } // if
+      overflow = Subscription::overflowDropOldest;
+    } // if
+
+    // a direct exchange only binds subs naming its exact key, a glob
+    // would be stored and never receive anything
+    if (st[0] == "direct" && st.trail(0).find_first_of("*?") != std::string::npos) {
+      peer->send_error("direct destinations can't hold wildcards");
       return;
-    } // else
+    } // if
+
+    sub = new Subscription(peer, id.str(), st.trail(0), ack);
+    sub->elogger( elogger(), elog_name() );
+    if (prefetch) sub->prefetch(prefetch);
+    sub->sendq_limit(max_bytes, max_messages, overflow);
+
+    if (is_headers) {
+      // openstomp.header.<name>:<value> gives a rule, all of them have to
+      // hold unless openstomp.header-match is any
+      static const std::string rule_prefix = "openstomp.header.";
+      for(size_t i=0; i < frame->num_headers(); i++) {
+        StompSlice name = frame->header_name(i);
+        if (name.length() <= rule_prefix.length()
+            || rule_prefix.compare(0, rule_prefix.length(), name.data(), rule_prefix.length()) != 0) continue;
+        sub->add_header_rule( std::string(name.data() + rule_prefix.length(), name.length() - rule_prefix.length()),
+                              frame->header_value(i).str() );
+      } // for
+      if (frame->get_header("openstomp.header-match", "") == "any")
+        sub->header_match(Subscription::headerMatchAny);
+    } // if
+
+    if (frame->is_header("selector")) {
+      try {
+        sub->selector( frame->get_header("selector") );
+      } // try
+      catch(StompInvalidSelector_Exception &ex) {
+        peer->send_error(ex.message());
+        sub->release();
+        return;
+      } // catch
+    } // if
+
+    _exch_manager->subscribe(sub);
+    sub->release();
   } // StompServer::_process_subscribe
 
+  // a client can only tighten the server's cap, never lift it
+  bool StompServer::_client_limit(StompFrame *frame, const std::string &name, const size_t cap, size_t &ret) {
+    ret = cap;
+
+    StompSlice value;
+    if (!frame->find_header(name.data(), name.length(), value)) return true;
+
+    size_t limit;
+    if (!value.to_size(limit)) return false;
+
+    // 0 asks for no cap at all, only the server can hand that out
+    if (limit && (!cap || limit < cap)) ret = limit;
+    return true;
+  } // StompServer::_client_limit
+
   void StompServer::_process_unsubscribe(StompPeer *peer, StompFrame *frame) {
     stompHeader_t headers;
 
-    if (!frame->is_header("id")) {
+    if (!frame->is_header(StompHeaders::headerId)) {
       peer->send_error("unsubscribe missing session id");
       return;
     } // if
-    std::string session_id = frame->get_header("id");
+    StompSlice session_id = frame->header(StompHeaders::headerId);
 
     Subscription *sub = peer->find_subscription(session_id);
     if (sub == NULL) {
@@ -536,9 +637,9 @@ namespace stomp {
   } // StompServer::_process_unsubscribe
 
   void StompServer::_process_receipt_id(StompPeer *peer, StompFrame *frame) {
-    if (!frame->is_header("receipt-id")) return;
+    if (!frame->is_header(StompHeaders::headerReceiptId)) return;
 
-    std::string receipt_id = frame->get_header("receipt-id");
+    StompSlice receipt_id = frame->header(StompHeaders::headerReceiptId);
     peer->receipt(receipt_id);
   } // StompServer::_process_receipt_id
 
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cassert>
+#include <cctype>
 #include <list>
 #include <map>
 #include <new>
@@ -28,7 +29,9 @@ namespace stomp {
   const time_t Subscription::kDefaultStatsInterval	= 5;
 
   Subscription::Subscription(StompPeer *peer, const string &id, const string &key, const ackModeEnum ack_mode) :
-      _peer(peer), _id(id), _key(key), _ack_mode(ack_mode), _prefetch(0) {
+      _peer(peer), _id(id), _key(key), _ack_mode(ack_mode), _sendq_bytes(0), _max_sendq_bytes(0), _max_sendq(0),
+      _overflow_policy(overflowDropOldest), _num_dropped(0), _overflowed(false), _sentq_head(0), _num_sent_holes(0), _prefetch(0),
+      _header_match(headerMatchAll), _selector(NULL) {
      assert(peer != NULL);
     _peer->retain();
     _peer->store_subscription(this);
@@ -44,16 +47,34 @@ namespace stomp {
     _peer->forget_subscription(this);
     _peer->release();
     delete _profile;
+    if (_selector != NULL) delete _selector;
   } // Subscription::~Subscription
 
   const bool Subscription::match(const string &key) const {
     return StringTool::match(_key.c_str(), key.c_str());
   } // match
 
+  // header names don't care about case, rules are kept by the lowercase
+  // name and the first rule given for a name is the one kept
+  bool Subscription::add_header_rule(const string &name, const string &value) {
+    string lower(name);
+    for(size_t i=0; i < lower.length(); i++) lower[i] = tolower( (unsigned char) lower[i] );
+    return _header_rules.insert( make_pair(lower, value) ).second;
+  } // Subscription::add_header_rule
+
+  Subscription &Subscription::selector(const string &expr) {
+    // compile first so a bad expr leaves the old one in place
+    Selector *selector = (expr.empty() ? NULL : new Selector(expr));
+    if (_selector != NULL) delete _selector;
+    _selector = selector;
+    return *this;
+  } // Subscription::selector
+
   void Subscription::init_stats(const time_t report_interval, const bool startup) {
     _stats.num_enqueued = 0;
     _stats.num_dequeued = 0;
     _stats.num_redelivered = 0;
+    _stats.num_dropped = 0;
     _stats.last_stats_at = time(NULL);
     if (report_interval) _stats.report_interval = report_interval;
     if (startup) _stats.created_at = time(NULL);
@@ -72,16 +93,57 @@ namespace stomp {
                      << " messages to " << this << std::endl);
     } // if
 
+    if (_stats.num_dropped) {
+        LOG(LogWarn, << "Subscription dropped " << _stats.num_dropped
+                     << " messages over its sendq limit; " << this << std::endl);
+    } // if
+
     init_stats();
     return true;
   } // Subscription::try_stats
 
   void Subscription::enqueue(StompMessage *smesg) {
+    if ( !has_room() ) {
+      switch(_overflow_policy) {
+        case overflowDropNewest:
+          dropped();
+          return;
+        case overflowDisconnect:
+          dropped();
+          if (!_overflowed) {
+            _overflowed = true;
+            LOG(LogWarn, << "Subscription disconnecting slow consumer; " << this << std::endl);
+            _peer->disconnect_with_error("slow consumer", "subscription "+_id+" is over its sendq limit");
+          } // if
+          return;
+        case overflowSpill:
+          // the queue holds messages back while is_spilling(), one still
+          // getting here is recovered or redelivered so it is kept
+          break;
+        case overflowDropOldest:
+        default:
+          while( !has_room() && !_sendq.empty() ) {
+            StompMessage *oldest = _sendq.front();
+            _sendq.pop_front();
+            _sendq_bytes -= oldest->body().length();
+            oldest->release();
+            dropped();
+          } // while
+          break;
+      } // switch
+    } // if
+
     smesg->retain();
     _sendq.push_back( smesg );
+    _sendq_bytes += smesg->body().length();
     _stats.num_enqueued++;
   } // Subscription::enqueue
 
+  void Subscription::dropped() {
+    _num_dropped++;
+    _stats.num_dropped++;
+  } // Subscription::dropped
+
   void Subscription::bind() {
     _peer->bind(this);
   } // Subscription::bind
@@ -96,80 +158,157 @@ namespace stomp {
     smesg = _sendq.front();
     smesg->inc_attempt();
     _sendq.pop_front();
-    if ( smesg->requires_resp() ) _sentq.push_back(smesg);
+    _sendq_bytes -= smesg->body().length();
+
+    // auto acked and topic deliveries are done once written, anything
+    // else waits in _sentq for its ACK with a reference of its own
+    bool is_tracked = (_ack_mode != ackModeAuto && smesg->requires_resp());
+    if (is_tracked) {
+      smesg->retain();
+      _sentq.push_back(smesg);
+      index_sent(smesg);
+    } // if
+    if ( !_credit_waiters.empty() ) credit_returned();
     return true;
   } // Subscription::dequeue_for_send
 
-  size_t Subscription::dequeue(const string &id) {
-    size_t num=0;
-    bool found = false;
+  void Subscription::index_sent(StompMessage *smesg) {
+    // message ids are generated by the server so each message is in
+    // _sentq at most once, a redelivery is only indexed after its old
+    // entry was unindexed
+    _sent_index[ smesg->header(StompHeaders::headerMessageId) ] = _sentq_head + _sentq.size() - 1;
+  } // Subscription::index_sent
+
+  void Subscription::unindex_sent(StompMessage *smesg) {
+    _sent_index.erase( smesg->header(StompHeaders::headerMessageId) );
+  } // Subscription::unindex_sent
+
+  bool Subscription::find_sent(const StompSlice &id, queue_st &ret) const {
+    sentIndex_citr citr = _sent_index.find(id);
+    if (citr == _sent_index.end()) return false;
+    ret = citr->second - _sentq_head;
+    return true;
+  } // Subscription::find_sent
 
+  // client acks everything up to id, client-individual only id
+  size_t Subscription::dequeue(const StompSlice &id) {
     openframe::Stopwatch sw;
     sw.Start();
 
-    queue_itr first, last;
-    first = _sentq.begin();
-    for(queue_itr itr = _sentq.begin(); itr != _sentq.end(); itr++) {
-      StompMessage *smesg = *itr;
-      if ( smesg->is_id(id) ) {
-        last = itr;
-        last++;	// .erase is not inclusive of last
-        found = true;
-        break;
-      } // if
-    } // for
+    queue_st pos;
+    bool found = find_sent(id, pos);
 
     _profile->average("dequeue", sw.Time());
 
-    if (!found) return num;
+    if (!found) return 0;
 
-    for(queue_itr itr = first; itr != last; itr++) {
-      StompMessage *smesg = *itr;
-      smesg->release();
-      _stats.num_dequeued++;
-      num++;
-    } // for
+    size_t num;
+    if (_ack_mode == ackModeClientIndv)
+      num = remove_sent(pos, false);
+    else
+      num = remove_sent_through(pos, false);
 
 //    LOG(LogInfo, << "Subscription dequeued " << num << "; " << this << std::endl);
-    _sentq.erase(first, last);
+    credit_returned();
 
     return num;
   } // Subscription::dequeue
 
-  size_t Subscription::redeliver(const string &id) {
-    size_t num=0;
-    bool found = false;
-
+  // a NACK covers the same messages an ACK would
+  size_t Subscription::redeliver(const StompSlice &id) {
     openframe::Stopwatch sw;
     sw.Start();
 
-    queue_itr first, last;
-    first = _sentq.begin();
-    for(queue_itr itr = _sentq.begin(); itr != _sentq.end(); itr++) {
-      StompMessage *smesg = *itr;
-      if ( smesg->is_id(id) ) {
-        last = itr;
-        last++;	// .erase is not inclusive of last
-        found = true;
-        break;
-      } // if
-    } // for
+    queue_st pos;
+    bool found = find_sent(id, pos);
 
     _profile->average("redelivered", sw.Time());
 
-    if (!found) return num;
+    if (!found) return 0;
+
+    size_t num;
+    if (_ack_mode == ackModeClientIndv)
+      num = remove_sent(pos, true);
+    else
+      num = remove_sent_through(pos, true);
 
+    credit_returned();
+
+    return num;
+  } // Subscription::redeliver
+
+  // erases the front of _sentq through pos in one go, the messages are
+  // released or kept for redelivery
+  size_t Subscription::remove_sent_through(const queue_st pos, const bool redeliver) {
+    size_t num = 0;
+    queue_itr first, last;
+    first = _sentq.begin();
+    last = first + pos + 1;	// .erase is not inclusive of last
     for(queue_itr itr = first; itr != last; itr++) {
       StompMessage *smesg = *itr;
-      _stats.num_redelivered++;
+      if (smesg == NULL) {
+        _num_sent_holes--;
+        continue;
+      } // if
+
+      unindex_sent(smesg);
+      if (redeliver) {
+        _deadq.push_back(smesg);
+        _stats.num_redelivered++;
+      } // if
+      else {
+        smesg->release();
+        _stats.num_dequeued++;
+      } // else
       num++;
     } // for
 
-    _deadq.insert(_deadq.end(), first, last);
     _sentq.erase(first, last);
-
+    _sentq_head += pos + 1;
     return num;
-  } // Subscription::redeliver
+  } // Subscription::remove_sent_through
+
+  // leaves a hole where the message was, see compact_sent()
+  size_t Subscription::remove_sent(const queue_st pos, const bool redeliver) {
+    StompMessage *smesg = _sentq[pos];
+    unindex_sent(smesg);
+    if (redeliver) {
+      _deadq.push_back(smesg);
+      _stats.num_redelivered++;
+    } // if
+    else {
+      smesg->release();
+      _stats.num_dequeued++;
+    } // else
+
+    _sentq[pos] = NULL;
+    _num_sent_holes++;
+    compact_sent();
+    return 1;
+  } // Subscription::remove_sent
+
+  // holes at the front go right away, the rest once they outnumber the
+  // messages still out, which keeps the reindex below amortized O(1)
+  void Subscription::compact_sent() {
+    while( !_sentq.empty() && _sentq.front() == NULL ) {
+      _sentq.pop_front();
+      _sentq_head++;
+      _num_sent_holes--;
+    } // while
+
+    if (_num_sent_holes <= sentq()) return;
+
+    queue_t sentq;
+    for(queue_itr itr = _sentq.begin(); itr != _sentq.end(); itr++) {
+      if (*itr != NULL) sentq.push_back(*itr);
+    } // for
+
+    _sentq.swap(sentq);
+    _num_sent_holes = 0;
+    _sent_index.clear();
+    for(queue_st i=0; i < _sentq.size(); i++)
+      _sent_index[ _sentq[i]->header(StompHeaders::headerMessageId) ] = _sentq_head + i;
+  } // Subscription::compact_sent
 
   mesgList_st Subscription::dequeue_dead(mesgList_t &ret, size_t limit) {
     mesgList_st num = 0;
@@ -194,17 +333,48 @@ namespace stomp {
       ret.push_back(smesg);
       _sendq.erase(itr);
     } // while
+    _sendq_bytes = 0;
 
+    _sentq_head += _sentq.size();
+    _sent_index.clear();
+    _num_sent_holes = 0;
     while( !_sentq.empty() ) {
       queue_itr itr = _sentq.begin();
       StompMessage *smesg = *itr;
-      ret.push_back(smesg);
+      if (smesg != NULL) ret.push_back(smesg);
       _sentq.erase(itr);
     } // while
 
     dequeue_dead(ret);
+    credit_returned();
   } // Subscription::dequeue_all
 
+  void Subscription::wait_for_credit(SubscriptionCredit_Interface *waiter) {
+    for(waiters_t::size_type i=0; i < _credit_waiters.size(); i++) {
+      if (_credit_waiters[i] == waiter) return;
+    } // for
+    _credit_waiters.push_back(waiter);
+  } // Subscription::wait_for_credit
+
+  void Subscription::forget_credit(SubscriptionCredit_Interface *waiter) {
+    for(waiters_t::size_type i=0; i < _credit_waiters.size(); i++) {
+      if (_credit_waiters[i] != waiter) continue;
+      _credit_waiters[i] = _credit_waiters.back();
+      _credit_waiters.pop_back();
+      return;
+    } // for
+  } // Subscription::forget_credit
+
+  void Subscription::credit_returned() {
+    if (_credit_waiters.empty() || !prefetch_ok() || is_spilling()) return;
+
+    // waiters are told once, they wait again if they run out
+    waiters_t waiters;
+    waiters.swap(_credit_waiters);
+    for(waiters_t::size_type i=0; i < waiters.size(); i++)
+      waiters[i]->onCredit(this);
+  } // Subscription::credit_returned
+
   const string Subscription::toString() const {
     stringstream out;
     out << "Subscription key=" << _key
@@ -224,6 +394,8 @@ namespace stomp {
         << ",dq/s=" << std::fixed << std::setprecision(2) << float(_stats.num_dequeued) / float(diff)
         << ",adq/s=" << std::fixed << std::setprecision(6) << _profile->average("dequeue")
         << ",prefetch=" << _prefetch
+        << ",bytes=" << _sendq_bytes
+        << ",dropped=" << _num_dropped
         << ",enqueued=" << std::setprecision(2) << std::fixed << float(_stats.num_enqueued)/1000 << "k"
         << ",dequeued=" << std::setprecision(2) << std::fixed << float(_stats.num_dequeued)/1000 << "k";
     return out.str();
@@ -0,0 +1,161 @@
+#include "config.h"
+
+#include <string>
+#include <cassert>
+#include <map>
+#include <vector>
+
+#include <string.h>
+
+#include <openframe/openframe.h>
+
+#include "Subscription.h"
+#include "SubscriptionTrie.h"
+
+namespace stomp {
+
+/**************************************************************************
+ ** SubscriptionTrie Class                                               **
+ **************************************************************************/
+  SubscriptionTrie::SubscriptionTrie() : _root(new node_t), _size(0) {
+  } // SubscriptionTrie::SubscriptionTrie
+
+  SubscriptionTrie::~SubscriptionTrie() {
+    destroy(_root);
+  } // SubscriptionTrie::~SubscriptionTrie
+
+  void SubscriptionTrie::destroy(node_t *node) {
+    for(edges_itr itr = node->edges.begin(); itr != node->edges.end(); itr++)
+      destroy(itr->second);
+    delete node;
+  } // SubscriptionTrie::destroy
+
+  void SubscriptionTrie::clear() {
+    destroy(_root);
+    _root = new node_t;
+    _size = 0;
+  } // SubscriptionTrie::clear
+
+  bool SubscriptionTrie::is_wildcard(const char *segment, const size_t len) {
+    for(size_t i=0; i < len; i++) {
+      if (segment[i] == '*' || segment[i] == '?') return true;
+    } // for
+    return false;
+  } // SubscriptionTrie::is_wildcard
+
+  bool SubscriptionTrie::erase(list_t &list, Subscription *sub) {
+    for(list_st i=0; i < list.size(); i++) {
+      if (list[i] != sub) continue;
+      list[i] = list.back();
+      list.pop_back();
+      return true;
+    } // for
+    return false;
+  } // SubscriptionTrie::erase
+
+  bool SubscriptionTrie::insert(Subscription *sub) {
+    assert(sub != NULL);	// bug
+    const std::string &key = sub->key();
+
+    node_t *node = _root;
+    size_t pos = 0;
+    while(true) {
+      size_t end = key.find('.', pos);
+      if (end == std::string::npos) end = key.length();
+
+      if (is_wildcard(key.data() + pos, end - pos)) {
+        node->wildcard.push_back(sub);
+        break;
+      } // if
+
+      std::string segment(key, pos, end - pos);
+      edges_itr itr = node->edges.find(segment);
+      if (itr == node->edges.end())
+        itr = node->edges.insert( make_pair(segment, new node_t) ).first;
+      node = itr->second;
+
+      if (end == key.length()) {
+        node->exact.push_back(sub);
+        break;
+      } // if
+      pos = end + 1;
+    } // while
+
+    _size++;
+    return true;
+  } // SubscriptionTrie::insert
+
+  bool SubscriptionTrie::remove(Subscription *sub) {
+    assert(sub != NULL);	// bug
+    const std::string &key = sub->key();
+
+    // remember the path so emptied nodes can be pruned on the way back
+    std::vector<std::pair<node_t *, edges_itr> > path;
+    node_t *node = _root;
+    size_t pos = 0;
+    bool found = false;
+    while(true) {
+      size_t end = key.find('.', pos);
+      if (end == std::string::npos) end = key.length();
+
+      if (is_wildcard(key.data() + pos, end - pos)) {
+        found = erase(node->wildcard, sub);
+        break;
+      } // if
+
+      edges_itr itr = node->edges.find( std::string(key, pos, end - pos) );
+      if (itr == node->edges.end()) break;
+      path.push_back( make_pair(node, itr) );
+      node = itr->second;
+
+      if (end == key.length()) {
+        found = erase(node->exact, sub);
+        break;
+      } // if
+      pos = end + 1;
+    } // while
+
+    if (!found) return false;
+
+    while( !path.empty() ) {
+      node_t *parent = path.back().first;
+      node_t *child = path.back().second->second;
+      if (!child->edges.empty() || !child->exact.empty() || !child->wildcard.empty()) break;
+      parent->edges.erase(path.back().second);
+      delete child;
+      path.pop_back();
+    } // while
+
+    _size--;
+    return true;
+  } // SubscriptionTrie::remove
+
+  SubscriptionTrie::list_st SubscriptionTrie::match(const std::string &key, list_t &ret) const {
+    list_st num = ret.size();
+    std::string segment;
+
+    const node_t *node = _root;
+    size_t pos = 0;
+    while(node != NULL) {
+      for(list_st i=0; i < node->wildcard.size(); i++) {
+        Subscription *sub = node->wildcard[i];
+        if ( sub->match(key) ) ret.push_back(sub);
+      } // for
+
+      size_t end = key.find('.', pos);
+      if (end == std::string::npos) end = key.length();
+
+      segment.assign(key, pos, end - pos);
+      edges_citr citr = node->edges.find(segment);
+      node = (citr == node->edges.end() ? NULL : citr->second);
+
+      if (node != NULL && end == key.length()) {
+        ret.insert(ret.end(), node->exact.begin(), node->exact.end());
+        break;
+      } // if
+      pos = end + 1;
+    } // while
+
+    return ret.size() - num;
+  } // SubscriptionTrie::match
+} // namespace stomp
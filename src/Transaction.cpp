@@ -21,8 +21,8 @@ namespace stomp {
 /**************************************************************************
  ** Transaction Class                                                    **
  **************************************************************************/
-  Transaction::Transaction(const std::string &key)
-              : _key(key) {
+  Transaction::Transaction(const StompSlice &key)
+              : _key(key.data(), key.length()) {
   } // Transaction::Transaction
 
   Transaction::~Transaction() {
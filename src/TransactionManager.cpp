@@ -27,17 +27,17 @@ namespace stomp {
     destroy_transactions();
   } // TransactionManager::~TransactionManager
 
-  Transaction *TransactionManager::create_transaction(const std::string &key) {
+  Transaction *TransactionManager::create_transaction(const StompSlice &key) {
     transaction_itr itr = _transactions.find(key);
     if (itr != _transactions.end()) return itr->second;
 
     Transaction *trans = new Transaction(key);
-    _transactions[key] = trans;
+    _transactions[ trans->key() ] = trans;
 
     return trans;
   } // TransactionManager::create_transaction
 
-  Transaction *TransactionManager::find_transaction(const std::string &key) {
+  Transaction *TransactionManager::find_transaction(const StompSlice &key) {
     transaction_itr itr = _transactions.find(key);
     if (itr == _transactions.end()) return NULL;
     return itr->second;
@@ -47,17 +47,18 @@ namespace stomp {
     while( !_transactions.empty() ) {
       transaction_itr itr = _transactions.begin();
       Transaction *trans = itr->second;
-      trans->release();
       _transactions.erase(itr);
+      trans->release();
     } // while
   } // TransactionManager::destroy_transactions
 
-  bool TransactionManager::destroy_transaction(const std::string &key) {
+  bool TransactionManager::destroy_transaction(const StompSlice &key) {
     transaction_itr itr = _transactions.find(key);
     if (itr == _transactions.end()) return false;
+    // the key goes with the transaction, erase before releasing
     Transaction *trans = itr->second;
-    trans->release();
     _transactions.erase(itr);
+    trans->release();
     return true;
   } // TransactionManager::destroy_transaction
 } // namespace stomp
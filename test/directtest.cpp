@@ -0,0 +1,118 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "ExchangeManager.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Checks a direct exchange binds only subs naming its exact key and
+// hands every message to each of them.
+stomp::StompPeer *_peer;
+
+void post(stomp::Exchange *exch, const size_t num) {
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+    exch->post(smesg);
+    smesg->release();
+  } // for
+} // post
+
+void test_bind() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::Exchange *exch = manager->create_exchange("direct/orders", stomp::Exchange::exchangeTypeDirect);
+  assert(exch->type() == stomp::Exchange::exchangeTypeDirect);
+  // the same key finds the same exchange
+  assert(manager->create_exchange("direct/orders", stomp::Exchange::exchangeTypeDirect) == exch);
+
+  const char *refused[] = { "direct/orders.*", "direct/*", "direct/order?", "direct/orders.eu", "direct/order" };
+  for(size_t i=0; i < sizeof(refused) / sizeof(char *); i++) {
+    stomp::Subscription *sub = new stomp::Subscription(_peer, "refused", refused[i]);
+    assert(!exch->bind(sub));
+    sub->release();
+  } // for
+  assert(exch->bind_size() == 0);
+
+  stomp::Subscription *exact = new stomp::Subscription(_peer, "exact", "direct/orders");
+  assert(exch->bind(exact) && !exch->bind(exact));
+  assert(exch->bind_size() == 1);
+
+  exch->unbind(exact);
+  exact->release();
+  manager->release();
+} // test_bind
+
+// stored subs are only bound to a new direct exchange on an exact match,
+// the glob a topic exchange would take is passed over
+void test_subscribe() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::Subscription *glob = new stomp::Subscription(_peer, "glob", "direct/*");
+  stomp::Subscription *exact = new stomp::Subscription(_peer, "exact", "direct/orders");
+  manager->subscribe(glob);
+  manager->subscribe(exact);
+
+  stomp::Exchange *exch = manager->create_exchange("direct/orders", stomp::Exchange::exchangeTypeDirect);
+  assert(exch->bind_size() == 1);
+  stomp::Exchange *other = manager->create_exchange("direct/refunds", stomp::Exchange::exchangeTypeDirect);
+  assert(other->bind_size() == 0);
+
+  manager->unsubscribe(glob);
+  manager->unsubscribe(exact);
+  assert(exch->bind_size() == 0);
+  glob->release();
+  exact->release();
+  manager->release();
+} // test_subscribe
+
+// every bind gets every message, unless its selector turns it down
+void test_dispatch() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::Exchange *exch = manager->create_exchange("direct/orders", stomp::Exchange::exchangeTypeDirect);
+
+  // nobody bound, they are dropped rather than held
+  post(exch, 5);
+  manager->dispatch_exchanges();
+  assert(exch->sendq_size() == 0 && !exch->is_parked());
+
+  stomp::Subscription *a = new stomp::Subscription(_peer, "a", "direct/orders");
+  stomp::Subscription *b = new stomp::Subscription(_peer, "b", "direct/orders");
+  stomp::Subscription *picky = new stomp::Subscription(_peer, "picky", "direct/orders");
+  picky->selector("missing IS NOT NULL");
+  assert(exch->bind(a) && exch->bind(b) && exch->bind(picky));
+
+  post(exch, 10);
+  manager->dispatch_exchanges();
+  assert(exch->sendq_size() == 0);
+  assert(a->sendq() == 10 && b->sendq() == 10 && picky->sendq() == 0);
+
+  exch->unbind(a);
+  exch->unbind(b);
+  exch->unbind(picky);
+  a->release();
+  b->release();
+  picky->release();
+  manager->release();
+} // test_dispatch
+
+int main(int argc, char **argv) {
+  _peer = new stomp::StompPeer(-1);
+
+  test_bind();
+  test_subscribe();
+  test_dispatch();
+
+  _peer->release();
+  std::cout << "directtest ok" << std::endl;
+  exit(0);
+} // main
@@ -0,0 +1,129 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "Exchange_Fanout.h"
+#include "StompMessage.h"
+
+// Queues messages with and without an inactivity timeout and checks the
+// expiry buckets only ever hold what is still in the queue.
+class Queue : public stomp::Exchange_Fanout {
+  public:
+    Queue() : stomp::Exchange_Fanout("queue/expiretest") { expire_interval(0); }
+    virtual ~Queue() { }
+
+    bool pop(stomp::StompMessage *&smesg) { return next_message(smesg); }
+    size_t expire() { return expire_inactive(); }
+    size_t num_filed() const {
+      size_t ret = 0;
+      for(expiries_t::const_iterator citr = _expiries.begin(); citr != _expiries.end(); citr++)
+        ret += citr->second.size();
+      return ret;
+    } // num_filed
+    size_t num_queued() const { return _sendq.size(); }
+
+  protected:
+  private:
+}; // class Queue
+
+typedef std::vector<stomp::StompMessage *> messages_t;
+
+// every message is ours and the queue's, timeouts spread over a few buckets
+void post(Queue *queue, messages_t &messages, const size_t num, const time_t timeout) {
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage("queue/expiretest", "body", timeout ? timeout + i % 3 : 0);
+    queue->post(smesg);
+    messages.push_back(smesg);
+  } // for
+} // post
+
+void release(messages_t &messages) {
+  for(size_t i=0; i < messages.size(); i++) {
+    // nobody else may be left holding it
+    assert(messages[i]->refcount() == 1);
+    assert(!messages[i]->expiry_at());
+    messages[i]->release();
+  } // for
+  messages.clear();
+} // release
+
+void test_drain() {
+  Queue *queue = new Queue();
+  messages_t messages;
+  post(queue, messages, 100, 3600);
+  post(queue, messages, 10, 0);
+  assert(queue->num_filed() == 100);
+
+  // leaving the queue takes them out of their buckets, long before due
+  stomp::StompMessage *smesg;
+  for(size_t i=0; queue->pop(smesg); i++) {
+    assert(smesg == messages[i]);
+    assert(queue->num_filed() == (i < 100 ? 99 - i : 0));
+    smesg->release();
+  } // for
+
+  release(messages);
+  queue->release();
+} // test_drain
+
+void test_destroy() {
+  Queue *queue = new Queue();
+  messages_t messages;
+  post(queue, messages, 50, 3600);
+
+  stomp::StompMessage *smesg;
+  assert(queue->pop(smesg));
+  smesg->release();
+
+  // the queue goes with messages still in it
+  queue->release();
+  release(messages);
+} // test_destroy
+
+void test_expire() {
+  Queue *queue = new Queue();
+  messages_t messages;
+  post(queue, messages, 20, 1);
+  post(queue, messages, 5, 0);
+
+  stomp::StompMessage *smesg;
+  assert(queue->pop(smesg) && smesg == messages[0]);
+  smesg->release();
+  assert(queue->num_filed() == 19);
+
+  sleep(4);
+
+  // the expired pass compaction, only the ones without a timeout are left
+  assert(queue->expire() == 19);
+  assert(queue->num_filed() == 0);
+  assert(queue->num_queued() == 5);
+  for(size_t i=1; i < 20; i++) assert(messages[i]->is_expired());
+
+  for(size_t i=20; queue->pop(smesg); i++) {
+    assert(smesg == messages[i]);
+    smesg->release();
+  } // for
+
+  release(messages);
+  queue->release();
+} // test_expire
+
+int main(int argc, char **argv) {
+  test_drain();
+  test_destroy();
+  test_expire();
+
+  std::cout << "expiretest ok" << std::endl;
+  exit(0);
+} // main
@@ -0,0 +1,167 @@
+#include <cassert>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "StompParser.h"
+#include "StompFrame.h"
+
+// Feeds hand made frames to the parser in every chunk size that matters
+// and checks what comes out, including the frames it has to turn down.
+class Parser : public stomp::StompParser {
+  public:
+    Parser() : num_errors(0), num_fatal(0) { }
+    virtual ~Parser() { }
+
+    virtual void onRecoverableError(stomp::StompFrame *frame) {
+      last_error = frame->get_header("message", "no message");
+      num_errors++;
+    } // onRecoverableError
+
+    virtual void onFatalError(stomp::StompFrame *frame) {
+      last_error = frame->get_header("message", "no message");
+      num_fatal++;
+    } // onFatalError
+
+    virtual void onBind(stomp::Subscription *sub) { }
+    virtual void onUnbind(stomp::Subscription *sub) { }
+
+    size_t num_errors;
+    size_t num_fatal;
+    std::string last_error;
+
+  protected:
+  private:
+}; // class Parser
+
+#define FRAME(x) std::string(x, sizeof(x) - 1)
+
+// feeds in chunks of step bytes, returns the frames parsed
+size_t feed(Parser *parser, const std::string &in, const size_t step, std::vector<stomp::StompFrame *> &ret) {
+  for(size_t i=0; i < in.length(); i += step) {
+    size_t len = std::min(step, in.length() - i);
+    parser->receive(in.data() + i, len);
+    while( parser->process() );
+  } // for
+
+  stomp::StompFrame *frame;
+  while( parser->dequeue(frame) ) ret.push_back(frame);
+  return ret.size();
+} // feed
+
+void release(std::vector<stomp::StompFrame *> &frames) {
+  for(size_t i=0; i < frames.size(); i++) frames[i]->release();
+  frames.clear();
+} // release
+
+void test_framing(const size_t step) {
+  std::string big(100000, 'x');
+  for(size_t i=0; i < big.length(); i += 37) big[i] = '\n';
+
+  std::string in = FRAME("SEND\r\ndestination:/queue/a\r\ncontent-length:5\nfoo: bar \nfoo:baz\n\nab\0de\0\n")
+                   + FRAME("\n\n")								// heart-beats
+                   + FRAME("MESSAGE\nx:y\n\nhello world\0")
+                   + FRAME("ACK\nid:1\n\n\0")
+                   + "SEND\ndestination:/queue/big\n\n" + big + std::string(1, '\0')
+                   + FRAME("SEND\ncontent-length:0\n\n\0");
+
+  Parser *parser = new Parser();
+  std::vector<stomp::StompFrame *> frames;
+  feed(parser, in, step, frames);
+
+  assert(frames.size() == 5);
+  assert(parser->num_errors == 0 && parser->num_fatal == 0);
+
+  // content-length bodies may hold NULs, the first of duplicate headers wins
+  assert(frames[0]->is_command(stomp::StompFrame::commandSend));
+  assert(frames[0]->body() == std::string("ab\0de", 5));
+  assert(frames[0]->get_header("destination") == "/queue/a");
+  assert(frames[0]->get_header("foo") == "bar");
+
+  assert(frames[1]->is_command(stomp::StompFrame::commandMessage));
+  assert(frames[1]->body() == "hello world");
+  assert(frames[2]->is_command(stomp::StompFrame::commandAck));
+  assert(frames[2]->body().empty());
+
+  // spans many scanner blocks
+  assert(frames[3]->body() == big);
+  assert(frames[4]->body().empty());
+
+  release(frames);
+  delete parser;
+} // test_framing
+
+void test_bad_header(const size_t step) {
+  Parser *parser = new Parser();
+  std::vector<stomp::StompFrame *> frames;
+  feed(parser, FRAME("SEND\nnocolon\n\n") + FRAME("ACK\nid:1\n\n\0"), step, frames);
+
+  // the header line is dropped and parsing picks up again
+  assert(parser->num_errors == 1 && parser->last_error == "unable to parse header");
+  assert(parser->num_fatal == 0);
+  release(frames);
+  delete parser;
+} // test_bad_header
+
+void test_content_length(const std::string &value, const size_t step) {
+  Parser *parser = new Parser();
+  std::vector<stomp::StompFrame *> frames;
+  feed(parser, "SEND\ncontent-length:" + value + "\n\nbody" + std::string(1, '\0') + FRAME("ACK\nid:1\n\n\0"), step, frames);
+
+  // nothing after it can be trusted so the peer goes
+  assert(parser->num_fatal == 1 && parser->last_error == "invalid content-length");
+  assert(frames.empty());
+  delete parser;
+} // test_content_length
+
+void test_max_frame_size(const size_t step) {
+  Parser *parser = new Parser();
+  parser->set_max_frame_size(1024);
+
+  std::vector<stomp::StompFrame *> frames;
+  feed(parser, "SEND\n\n" + std::string(1000, 'x') + std::string(1, '\0'), step, frames);
+  assert(frames.size() == 1 && parser->num_fatal == 0);
+  release(frames);
+
+  // NUL framed, never terminated
+  feed(parser, "SEND\n\n" + std::string(2048, 'x'), step, frames);
+  assert(frames.empty());
+  assert(parser->num_fatal == 1 && parser->last_error == "frame too large");
+  delete parser;
+
+  parser = new Parser();
+  parser->set_max_frame_size(1024);
+  feed(parser, FRAME("SEND\ncontent-length:1025\n\n"), step, frames);
+  assert(parser->num_fatal == 1 && parser->last_error == "invalid content-length");
+  delete parser;
+} // test_max_frame_size
+
+int main(int argc, char **argv) {
+  const size_t steps[] = { 1, 2, 3, 7, 64, 4095, 4096, 4097, 1048576 };
+  const size_t num_steps = sizeof(steps) / sizeof(size_t);
+
+  for(size_t i=0; i < num_steps; i++) {
+    test_framing(steps[i]);
+    test_bad_header(steps[i]);
+    test_content_length("-1", steps[i]);
+    test_content_length("", steps[i]);
+    test_content_length("12a", steps[i]);
+    test_content_length("18446744073709551616", steps[i]);
+    test_content_length("99999999999999999999999", steps[i]);
+    test_max_frame_size(steps[i]);
+  } // for
+
+  std::cout << "framingtest ok" << std::endl;
+  exit(0);
+} // main
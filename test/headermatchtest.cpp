@@ -0,0 +1,143 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "Exchange_Headers.h"
+#include "ExchangeManager.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Routes messages through a headers exchange and checks each bind gets
+// exactly what its all or any rules ask for.
+stomp::StompPeer *_peer;
+
+void post(stomp::Exchange *exch, const std::string &type, const std::string &region) {
+  stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+  if (!type.empty()) smesg->add_header("type", type);
+  if (!region.empty()) smesg->add_header("region", region);
+  exch->post(smesg);
+  smesg->release();
+} // post
+
+size_t drain(stomp::Subscription *sub) {
+  size_t num;
+  stomp::StompMessage *smesg;
+  for(num=0; sub->dequeue_for_send(smesg); num++) smesg->release();
+  return num;
+} // drain
+
+stomp::Subscription *subscription(const std::string &id, const stomp::Subscription::headerMatchEnum header_match) {
+  stomp::Subscription *sub = new stomp::Subscription(_peer, id, "headers/headermatchtest");
+  sub->header_match(header_match);
+  return sub;
+} // subscription
+
+void test_match() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::Exchange_Headers *exch = dynamic_cast<stomp::Exchange_Headers *>( manager->create_exchange("headers/headermatchtest", stomp::Exchange::exchangeTypeHeaders) );
+  assert(exch != NULL);
+
+  stomp::Subscription *all = subscription("all", stomp::Subscription::headerMatchAll);
+  assert(all->add_header_rule("type", "alert") && all->add_header_rule("region", "eu"));
+  // the first rule for a name is kept, in any case
+  assert(!all->add_header_rule("TYPE", "info"));
+
+  stomp::Subscription *any = subscription("any", stomp::Subscription::headerMatchAny);
+  assert(any->add_header_rule("Type", "alert") && any->add_header_rule("REGION", "us"));
+
+  stomp::Subscription *everything = subscription("everything", stomp::Subscription::headerMatchAll);
+
+  assert(exch->bind(all) && exch->bind(any) && exch->bind(everything));
+  assert(exch->index_size() == 2);
+
+  post(exch, "alert", "eu");	// all, any
+  post(exch, "alert", "us");	// any
+  post(exch, "info", "us");	// any
+  post(exch, "info", "eu");	// nobody with rules
+  post(exch, "alert", "");	// any
+  post(exch, "", "eu");		// nobody with rules
+  post(exch, "ALERT", "EU");	// values keep their case
+  manager->dispatch_exchanges();
+
+  assert(exch->sendq_size() == 0);
+  assert(all->sendq() == 1);
+  assert(any->sendq() == 4);
+  assert(everything->sendq() == 7);
+
+  // header names are matched in any case on the message side too
+  stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+  smesg->add_header("TYPE", "alert");
+  smesg->add_header("Region", "eu");
+  exch->post(smesg);
+  smesg->release();
+  manager->dispatch_exchanges();
+  assert(all->sendq() == 2 && any->sendq() == 5);
+
+  // the index goes with the last bind that needed it, what they hold
+  // would go back to the exchange so it's sent first
+  assert(drain(all) == 2 && drain(any) == 5);
+  exch->unbind(all);
+  assert(exch->index_size() == 2);
+  exch->unbind(any);
+  assert(exch->index_size() == 0);
+
+  post(exch, "alert", "eu");
+  manager->dispatch_exchanges();
+  assert(all->sendq() == 0 && any->sendq() == 0 && everything->sendq() == 9);
+
+  exch->unbind(everything);
+  all->release();
+  any->release();
+  everything->release();
+  manager->release();
+} // test_match
+
+// a freed slot is reused without the old bind's hits leaking into it
+void test_reuse() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::Exchange *exch = manager->create_exchange("headers/headermatchtest", stomp::Exchange::exchangeTypeHeaders);
+
+  stomp::Subscription *first = subscription("first", stomp::Subscription::headerMatchAny);
+  first->add_header_rule("type", "alert");
+  assert(exch->bind(first));
+  post(exch, "alert", "eu");
+  manager->dispatch_exchanges();
+  assert(first->sendq() == 1);
+  exch->unbind(first);
+
+  stomp::Subscription *second = subscription("second", stomp::Subscription::headerMatchAll);
+  second->add_header_rule("type", "alert");
+  second->add_header_rule("region", "us");
+  assert(exch->bind(second));
+  post(exch, "alert", "eu");
+  post(exch, "alert", "us");
+  manager->dispatch_exchanges();
+  assert(second->sendq() == 1);
+
+  exch->unbind(second);
+  first->release();
+  second->release();
+  manager->release();
+} // test_reuse
+
+int main(int argc, char **argv) {
+  _peer = new stomp::StompPeer(-1);
+
+  test_match();
+  test_reuse();
+
+  _peer->release();
+  std::cout << "headermatchtest ok" << std::endl;
+  exit(0);
+} // main
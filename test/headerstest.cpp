@@ -0,0 +1,149 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "StompHeaders.h"
+
+// Runs random adds, replaces and removes against a plain vector of
+// name/value pairs and checks the arena agrees with it after every step.
+class Headers : public stomp::StompHeaders {
+  public:
+    Headers() { }
+    virtual ~Headers() { }
+
+    size_t length() const { return headers_length(); }
+    std::string lines() const {
+      std::string ret;
+      append_headers(ret);
+      return ret;
+    } // lines
+
+  protected:
+  private:
+}; // class Headers
+
+typedef std::vector<std::pair<std::string, std::string> > model_t;
+
+void check(const Headers *headers, const model_t &model) {
+  std::string lines;
+  for(size_t i=0; i < model.size(); i++)
+    lines += model[i].first + ":" + model[i].second + "\n";
+
+  assert(headers->num_headers() == model.size());
+  assert(headers->lines() == lines);
+  // frames reserve and report their size from this
+  assert(headers->length() == lines.length());
+} // check
+
+std::string randvalue() {
+  // mostly short with the odd value big enough to leave the inline arena
+  size_t len = (rand() % 10 == 0 ? rand() % 600 : rand() % 24);
+  std::string ret;
+  for(size_t i=0; i < len; i++) ret += (char) ('a' + rand() % 26);
+  return ret;
+} // randvalue
+
+void test_random(const size_t num_ops) {
+  static const char *names[] = { "destination", "message-id", "subscription", "content-length",
+                                 "x-a", "x-b", "x-c", "x-d", "x-e", "x-f", "x-g", "x-h", "x-i" };
+  const size_t num_names = sizeof(names) / sizeof(char *);
+
+  Headers *headers = new Headers();
+  model_t model;
+
+  for(size_t op=0; op < num_ops; op++) {
+    std::string name = names[rand() % num_names];
+    std::string value = randvalue();
+
+    size_t i;
+    for(i=0; i < model.size() && model[i].first != name; i++);
+
+    switch(rand() % 4) {
+      case 0:
+        // the first of a name wins, duplicates are dropped
+        headers->add_header(name, value);
+        if (i == model.size()) model.push_back( std::make_pair(name, value) );
+        break;
+      case 1:
+      case 2:
+        headers->replace_header(name, value);
+        if (i == model.size())
+          model.push_back( std::make_pair(name, value) );
+        else
+          model[i].second = value;
+        break;
+      case 3:
+        // missing headers throw
+        if (i == model.size()) break;
+        headers->remove_header(name);
+        model.erase(model.begin() + i);
+        break;
+    } // switch
+
+    check(headers, model);
+    for(i=0; i < model.size(); i++) assert(headers->get_header(model[i].first) == model[i].second);
+  } // for
+
+  headers->release();
+} // test_random
+
+void test_grow_compact() {
+  Headers *headers = new Headers();
+  model_t model;
+
+  headers->add_header("x-a", std::string(100, 'a'));
+  headers->add_header("x-b", "b");
+  model.push_back( std::make_pair(std::string("x-a"), std::string(100, 'a')) );
+  model.push_back( std::make_pair(std::string("x-b"), std::string("b")) );
+
+  // each value outgrows the last, the dead ones pile up until append()
+  // compacts in the middle of an assign
+  for(size_t len=2; len < 120; len++) {
+    std::string value(len, 'b');
+    headers->replace_header("x-b", value);
+    model[1].second = value;
+    check(headers, model);
+  } // for
+
+  headers->release();
+} // test_grow_compact
+
+void test_classify() {
+  assert(Headers::classify("destination", 11) == stomp::StompHeaders::headerDestination);
+  assert(Headers::classify("Content-Length", 14) == stomp::StompHeaders::headerContentLength);
+  assert(Headers::classify("MESSAGE-ID", 10) == stomp::StompHeaders::headerMessageId);
+  assert(Headers::classify("x-destinat", 10) == stomp::StompHeaders::headerUnknown);
+
+  // names off the wire may hold any byte, at every length that switches
+  // on the first one
+  const size_t lens[] = { 7, 10, 11, 12 };
+  for(size_t i=0; i < sizeof(lens) / sizeof(size_t); i++) {
+    for(int c=128; c < 256; c++) {
+      std::string name(lens[i], 'x');
+      name[0] = (char) c;
+      assert(Headers::classify(name.data(), name.length()) == stomp::StompHeaders::headerUnknown);
+    } // for
+  } // for
+} // test_classify
+
+int main(int argc, char **argv) {
+  srand(1);
+
+  test_classify();
+  test_grow_compact();
+  for(size_t i=0; i < 200; i++) test_random(200);
+
+  std::cout << "headerstest ok" << std::endl;
+  exit(0);
+} // main
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <new>
 #include <string>
+#include <vector>
 
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +15,9 @@
 
 #include "StompParser.h"
 #include "StompFrame.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
 
 #include "Feed.h"
 
@@ -50,11 +54,145 @@ bool try_ack(const bool force=false) {
   return true;
 } // try_ack
 
+typedef std::vector<stomp::StompMessage *> messages_t;
+
+// sends num messages posted with the same SEND frame, ids are the server's
+stomp::Subscription *sent(const stomp::Subscription::ackModeEnum ack_mode, const size_t num, messages_t &ret) {
+  stomp::StompPeer *peer = new stomp::StompPeer(-1);
+  stomp::Subscription *sub = new stomp::Subscription(peer, "nacktest", "queue/nacktest", ack_mode);
+  peer->release();
+
+  stomp::StompFrame *frame = new stomp::StompFrame("SEND", "body");
+  frame->add_header("destination", "/queue/nacktest");
+  frame->add_header("message-id", "client-chosen");
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage("queue/nacktest", frame);
+    assert(smesg->id() != "client-chosen");
+    assert(smesg->get_header("destination") == "/queue/nacktest");
+    sub->enqueue(smesg);
+    ret.push_back(smesg);
+  } // for
+  frame->release();
+
+  stomp::StompMessage *smesg;
+  while( sub->dequeue_for_send(smesg) ) smesg->release();
+  return sub;
+} // sent
+
+void release(stomp::Subscription *sub, messages_t &messages) {
+  stomp::mesgList_t ml;
+  sub->dequeue_all(ml);
+  for(size_t i=0; i < ml.size(); i++) ml[i]->release();
+  sub->release();
+
+  for(size_t i=0; i < messages.size(); i++) messages[i]->release();
+  messages.clear();
+} // release
+
+// a message-id on the SEND must not make two deliveries look alike
+void test_client_ids() {
+  messages_t messages;
+  stomp::Subscription *sub = sent(stomp::Subscription::ackModeClientIndv, 3, messages);
+  assert(messages[0]->id() != messages[1]->id());
+  assert(sub->dequeue(messages[1]->id()) == 1);
+  assert(sub->dequeue(messages[0]->id()) == 1);
+  assert(sub->dequeue(messages[2]->id()) == 1);
+  assert(sub->sentq() == 0);
+  release(sub, messages);
+
+  sub = sent(stomp::Subscription::ackModeClient, 3, messages);
+  assert(sub->dequeue(messages[1]->id()) == 2);
+  assert(sub->sentq() == 1);
+  release(sub, messages);
+} // test_client_ids
+
+// acks and nacks land on the message they name in any order, holes left
+// behind get compacted away without losing the index
+void test_out_of_order() {
+  messages_t messages;
+  stomp::Subscription *sub = sent(stomp::Subscription::ackModeClientIndv, 10, messages);
+  assert(sub->sentq() == 10);
+
+  const size_t order[] = { 5, 2, 8, 3, 9, 7, 4 };
+  for(size_t i=0; i < sizeof(order) / sizeof(size_t); i++) {
+    const std::string id = messages[order[i]]->id();
+    // odd ones are nacked
+    size_t num = (i % 2 ? sub->redeliver(id) : sub->dequeue(id));
+    assert(num == 1);
+    assert(sub->sentq() == 10 - i - 1);
+    // gone either way
+    assert(sub->dequeue(id) == 0 && sub->redeliver(id) == 0);
+  } // for
+
+  // the holes outnumber what is still out so the index was rebuilt
+  assert(sub->sentq() == 3);
+  assert(sub->dequeue(messages[6]->id()) == 1);
+  assert(sub->redeliver(messages[1]->id()) == 1);
+  assert(sub->dequeue(messages[0]->id()) == 1);
+  assert(sub->sentq() == 0);
+
+  stomp::mesgList_t ml;
+  sub->dequeue_dead(ml, 0);
+  assert(ml.size() == 4);
+  assert(ml[0] == messages[2] && ml[1] == messages[3] && ml[2] == messages[7] && ml[3] == messages[1]);
+  for(size_t i=0; i < ml.size(); i++) ml[i]->release();
+  release(sub, messages);
+} // test_out_of_order
+
+// what is acked or nacked no longer counts against prefetch
+void test_prefetch() {
+  messages_t messages;
+  stomp::Subscription *sub = sent(stomp::Subscription::ackModeClientIndv, 4, messages);
+  sub->prefetch(4);
+  assert(sub->sentq() == 4 && !sub->prefetch_ok());
+  assert(sub->dequeue(messages[2]->id()) == 1);
+  assert(sub->sentq() == 3 && sub->prefetch_ok());
+  assert(sub->redeliver(messages[0]->id()) == 1);
+  assert(sub->sentq() == 2 && sub->prefetch_ok());
+
+  stomp::mesgList_t ml;
+  sub->dequeue_dead(ml, 0);
+  for(size_t i=0; i < ml.size(); i++) ml[i]->release();
+  release(sub, messages);
+
+  // client mode acks everything up to the id
+  sub = sent(stomp::Subscription::ackModeClient, 4, messages);
+  sub->prefetch(4);
+  assert(!sub->prefetch_ok());
+  assert(sub->dequeue(messages[2]->id()) == 3);
+  assert(sub->sentq() == 1 && sub->prefetch_ok());
+  assert(sub->dequeue(messages[1]->id()) == 0);
+  assert(sub->redeliver(messages[3]->id()) == 1);
+  assert(sub->sentq() == 0);
+
+  ml.clear();
+  sub->dequeue_dead(ml, 0);
+  assert(ml.size() == 1 && ml[0] == messages[3]);
+  ml[0]->release();
+  release(sub, messages);
+} // test_prefetch
+
+// nothing is kept around waiting for an ack that never comes
+void test_auto() {
+  messages_t messages;
+  stomp::Subscription *sub = sent(stomp::Subscription::ackModeAuto, 10, messages);
+  sub->prefetch(4);
+  assert(sub->sentq() == 0 && sub->prefetch_ok());
+  assert(sub->dequeue(messages[3]->id()) == 0);
+  for(size_t i=0; i < messages.size(); i++) assert(messages[i]->refcount() == 1);
+  release(sub, messages);
+} // test_auto
+
 int main(int argc, char **argv) {
 
+  // without a host only the ack bookkeeping is checked
   if (argc < 2) {
-    std::cerr << "ERROR missing host argument" << std::endl;
-    exit(1);
+    test_client_ids();
+    test_out_of_order();
+    test_prefetch();
+    test_auto();
+    std::cout << "nacktest ok" << std::endl;
+    exit(0);
   } // if
 
   std::string host = argv[1];
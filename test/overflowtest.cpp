@@ -0,0 +1,151 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "ExchangeManager.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Fills subscription sendqs past their limit under each overflow policy
+// and checks spill only ever holds back a queue.
+void post(stomp::Exchange *exch, const size_t num) {
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+    exch->post(smesg);
+    smesg->release();
+  } // for
+} // post
+
+size_t drain(stomp::Subscription *sub, const size_t limit) {
+  size_t num;
+  stomp::StompMessage *smesg;
+  for(num=0; num < limit && sub->dequeue_for_send(smesg); num++) smesg->release();
+  return num;
+} // drain
+
+void test_policies() {
+  for(int policy = stomp::Subscription::overflowDropOldest; policy <= stomp::Subscription::overflowSpill; policy++) {
+    stomp::StompPeer *peer = new stomp::StompPeer(-1);
+    stomp::Subscription *sub = new stomp::Subscription(peer, "overflowtest", "queue/overflowtest");
+    sub->sendq_limit(0, 3, (stomp::Subscription::overflowPolicyEnum) policy);
+
+    // we keep a reference to the oldest to see whether it was dropped
+    stomp::StompMessage *first = new stomp::StompMessage("queue/overflowtest", "body");
+    sub->enqueue(first);
+    for(size_t i=1; i < 10; i++) {
+      stomp::StompMessage *smesg = new stomp::StompMessage("queue/overflowtest", "body");
+      sub->enqueue(smesg);
+      smesg->release();
+    } // for
+
+    switch(policy) {
+      case stomp::Subscription::overflowSpill:
+        // nothing holds these back when enqueued by hand, they are kept
+        assert(sub->sendq() == 10 && sub->num_dropped() == 0);
+        break;
+      case stomp::Subscription::overflowDropOldest:
+        assert(sub->sendq() == 3 && sub->num_dropped() == 7);
+        assert(first->refcount() == 1);
+        break;
+      default:
+        assert(sub->sendq() == 3 && sub->num_dropped() == 7);
+        assert(first->refcount() == 2);
+        break;
+    } // switch
+    assert(sub->sendq_bytes() == sub->sendq() * 4);
+    assert(peer->disconnect() == (policy == stomp::Subscription::overflowDisconnect));
+
+    first->release();
+    drain(sub, 100);
+    assert(sub->sendq_bytes() == 0);
+    sub->release();
+    peer->release();
+  } // for
+} // test_policies
+
+// a full spilling sub leaves the rest in the queue until it drains
+void test_queue_spill() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::StompPeer *peer = new stomp::StompPeer(-1);
+  stomp::Exchange *exch = manager->create_exchange("queue/overflowtest", stomp::Exchange::exchangeTypeFanout);
+  stomp::Subscription *sub = new stomp::Subscription(peer, "overflowtest", "queue/overflowtest");
+  sub->sendq_limit(0, 5, stomp::Subscription::overflowSpill);
+  assert(exch->bind(sub));
+
+  post(exch, 20);
+  for(size_t i=0; i < 5; i++) manager->dispatch_exchanges();
+  assert(sub->sendq() == 5 && sub->num_dropped() == 0);
+  assert(exch->sendq_size() == 15 && exch->is_parked());
+
+  // the credit wakes the queue
+  assert(drain(sub, 3) == 3);
+  assert(!exch->is_parked());
+  manager->dispatch_exchanges();
+  assert(sub->sendq() == 5 && exch->sendq_size() == 12);
+
+  size_t num = 3;
+  for(size_t i=0; i < 20; i++) {
+    num += drain(sub, 100);
+    manager->dispatch_exchanges();
+  } // for
+  assert(num == 20 && exch->sendq_size() == 0 && sub->num_dropped() == 0);
+
+  exch->unbind(sub);
+  sub->release();
+  peer->release();
+  manager->release();
+} // test_queue_spill
+
+// shared exchanges never park for one sub, spill subs aren't bound to them
+void test_shared_spill(const std::string &key, const stomp::Exchange::exchangeTypeEnum type) {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::StompPeer *peer = new stomp::StompPeer(-1);
+  stomp::Exchange *exch = manager->create_exchange(key, type);
+
+  stomp::Subscription *spill = new stomp::Subscription(peer, "spill", key);
+  spill->sendq_limit(0, 5, stomp::Subscription::overflowSpill);
+  assert(!exch->bind(spill));
+  spill->release();
+
+  stomp::Subscription *slow = new stomp::Subscription(peer, "slow", key);
+  slow->sendq_limit(0, 5, stomp::Subscription::overflowDropOldest);
+  stomp::Subscription *fast = new stomp::Subscription(peer, "fast", key);
+  assert(exch->bind(slow) && exch->bind(fast));
+
+  post(exch, 20);
+  for(size_t i=0; i < 5; i++) manager->dispatch_exchanges();
+
+  // the slow sub loses its oldest, the other still gets everything
+  assert(!exch->is_parked() && exch->sendq_size() == 0);
+  assert(slow->sendq() == 5 && slow->num_dropped() == 15);
+  assert(fast->sendq() == 20);
+
+  exch->unbind(slow);
+  exch->unbind(fast);
+  slow->release();
+  fast->release();
+  peer->release();
+  manager->release();
+} // test_shared_spill
+
+int main(int argc, char **argv) {
+  test_policies();
+  test_queue_spill();
+  test_shared_spill("topic/overflowtest", stomp::Exchange::exchangeTypeTopic);
+  test_shared_spill("direct/overflowtest", stomp::Exchange::exchangeTypeDirect);
+  test_shared_spill("headers/overflowtest", stomp::Exchange::exchangeTypeHeaders);
+
+  std::cout << "overflowtest ok" << std::endl;
+  exit(0);
+} // main
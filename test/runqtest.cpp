@@ -0,0 +1,110 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "ExchangeManager.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Checks only exchanges with work sit on the run queue and a parked one
+// stays off it until the credit it waits for comes back.
+void post(stomp::Exchange *exch, const size_t num) {
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+    exch->post(smesg);
+    smesg->release();
+  } // for
+} // post
+
+// idle exchanges are never queued, busy ones once however much they get
+void test_idle() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  std::vector<stomp::Exchange *> exchanges;
+  for(size_t i=0; i < 1000; i++) {
+    std::stringstream s;
+    s << "queue/runqtest." << i;
+    exchanges.push_back( manager->create_exchange(s.str(), stomp::Exchange::exchangeTypeFanout) );
+  } // for
+  assert(manager->runq_size() == 0);
+  manager->dispatch_exchanges();
+  assert(manager->runq_size() == 0);
+
+  post(exchanges[10], 5);
+  post(exchanges[10], 5);
+  post(exchanges[500], 1);
+  assert(manager->runq_size() == 2);
+
+  // nobody is bound to take them, they wait without being revisited
+  manager->dispatch_exchanges();
+  assert(exchanges[10]->sendq_size() == 10 && exchanges[500]->sendq_size() == 1);
+  assert(manager->runq_size() == 0);
+
+  // a destroyed exchange's entry is skipped
+  post(exchanges[20], 1);
+  assert(manager->runq_size() == 1);
+  assert(manager->destroy_exchange("queue/runqtest.20"));
+  manager->dispatch_exchanges();
+  assert(manager->runq_size() == 0);
+
+  manager->release();
+} // test_idle
+
+void test_park() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::StompPeer *peer = new stomp::StompPeer(-1);
+  stomp::Exchange *exch = manager->create_exchange("queue/runqtest", stomp::Exchange::exchangeTypeFanout);
+  stomp::Subscription *sub = new stomp::Subscription(peer, "runqtest", "queue/runqtest", stomp::Subscription::ackModeClientIndv);
+  sub->prefetch(1);
+  assert(exch->bind(sub));
+
+  post(exch, 1);
+  manager->dispatch_exchanges();
+  assert(sub->sendq() == 1 && exch->sendq_size() == 0);
+
+  // out of prefetch once sent, the next pass parks the queue
+  stomp::StompMessage *smesg;
+  assert(sub->dequeue_for_send(smesg));
+  post(exch, 2);
+  manager->dispatch_exchanges();
+  assert(exch->is_parked() && exch->sendq_size() == 2);
+  assert(manager->runq_size() == 0);
+
+  // more work doesn't wake it, nor do passes
+  post(exch, 1);
+  for(size_t i=0; i < 5; i++) manager->dispatch_exchanges();
+  assert(exch->is_parked() && exch->sendq_size() == 3);
+  assert(manager->runq_size() == 0);
+
+  // the ack hands the credit back and the queue runs again
+  assert(sub->dequeue( smesg->id() ) == 1);
+  smesg->release();
+  assert(!exch->is_parked() && manager->runq_size() == 1);
+  manager->dispatch_exchanges();
+  assert(sub->sendq() == 3 && exch->sendq_size() == 0);
+
+  exch->unbind(sub);
+  sub->release();
+  peer->release();
+  manager->release();
+} // test_park
+
+int main(int argc, char **argv) {
+  test_idle();
+  test_park();
+
+  std::cout << "runqtest ok" << std::endl;
+  exit(0);
+} // main
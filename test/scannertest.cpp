@@ -0,0 +1,99 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "StompScanner.h"
+
+// Runs every scanner the cpu can take over random buffers at every
+// alignment and checks each finds the same boundaries as a plain loop.
+class Scanner : public stomp::StompScanner {
+  public:
+    typedef boundaries_st (*scanFunc_t)(const char *, const size_t, const size_t, boundaries_t &);
+
+    static std::vector<std::pair<std::string, scanFunc_t> > scanners() {
+      std::vector<std::pair<std::string, scanFunc_t> > ret;
+      ret.push_back( std::make_pair(std::string("bytes"), &scan_bytes) );
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse2")) ret.push_back( std::make_pair(std::string("sse2"), &scan_sse2) );
+      if (__builtin_cpu_supports("avx2")) ret.push_back( std::make_pair(std::string("avx2"), &scan_avx2) );
+#endif
+      return ret;
+    } // scanners
+
+  protected:
+  private:
+}; // class Scanner
+
+void expected(const char *buf, const size_t len, const size_t base, stomp::StompScanner::boundaries_t &ret) {
+  for(size_t i=0; i < len; i++) {
+    if (buf[i] == '\n' || buf[i] == '\0') ret.push_back(base + i);
+  } // for
+} // expected
+
+// mostly bytes that sit next to the boundaries in value, the odd one
+// over 127 so signed compares would get it wrong
+char randbyte(const size_t density) {
+  static const char others[] = { 'a', '\x01', '\x09', '\x0b', '\x8a', '\x80', '\xff' };
+  switch(rand() % density) {
+    case 0: return '\n';
+    case 1: return '\0';
+    default: return others[rand() % sizeof(others)];
+  } // switch
+} // randbyte
+
+void test_scanner(const std::string &name, Scanner::scanFunc_t scan) {
+  // room for every alignment on either side of a 64 byte span
+  std::vector<char> buf(1024 + 64);
+
+  for(size_t round=0; round < 2000; round++) {
+    size_t density = 2 + rand() % 64;
+    for(size_t i=0; i < buf.size(); i++) buf[i] = randbyte(density);
+
+    size_t offset = rand() % 64;
+    size_t len = (round < 200 ? round : rand() % 1024);
+    size_t base = rand() % 100000;
+
+    // results are appended, what's there already stays
+    stomp::StompScanner::boundaries_t want(1, 42), got(1, 42);
+    expected(&buf[offset], len, base, want);
+    size_t num = scan(&buf[offset], len, base, got);
+    assert(num == want.size() - 1);
+    if (got != want) {
+      std::cerr << name << " disagrees at offset " << offset << " len " << len << std::endl;
+      assert(false);
+    } // if
+  } // for
+
+  // all boundaries and none
+  std::string all(300, '\n'), none(300, 'x');
+  stomp::StompScanner::boundaries_t ret;
+  assert(scan(all.data(), all.length(), 0, ret) == 300 && ret.back() == 299);
+  ret.clear();
+  assert(scan(none.data(), none.length(), 0, ret) == 0 && ret.empty());
+} // test_scanner
+
+int main(int argc, char **argv) {
+  srand(1);
+
+  std::vector<std::pair<std::string, Scanner::scanFunc_t> > scanners = Scanner::scanners();
+  for(size_t i=0; i < scanners.size(); i++) test_scanner(scanners[i].first, scanners[i].second);
+
+  // and through the one scan() picked
+  stomp::StompScanner::boundaries_t ret;
+  assert(stomp::StompScanner::scan("a\nb\0", 4, 10, ret) == 2 && ret[0] == 11 && ret[1] == 13);
+
+  std::cout << "scannertest ok (" << stomp::StompScanner::isa() << ")" << std::endl;
+  exit(0);
+} // main
@@ -0,0 +1,230 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "ExchangeManager.h"
+#include "Selector.h"
+#include "StompFrame.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Runs selectors against a fixed set of headers, then checks a queue only
+// drops what no bound selector will ever take.
+stomp::StompFrame *_headers;
+
+bool match(const std::string &expr) {
+  stomp::Selector selector(expr);
+  return selector.match(_headers);
+} // match
+
+bool is_invalid(const std::string &expr) {
+  try {
+    stomp::Selector selector(expr);
+  } // try
+  catch(stomp::StompInvalidSelector_Exception &ex) {
+    return true;
+  } // catch
+  return false;
+} // is_invalid
+
+void test_tokens() {
+  assert(match("type = 'alert'"));
+  assert(match("  type='alert'  "));
+  assert(match("type <> 'info' AND type != 'info'"));
+  // a doubled quote stands for itself, in literals and identifiers
+  assert(match("quote = 'it''s'"));
+  assert(match("\"x-odd name\" = 'yes'"));
+  // '-' and ':' may be part of a name, there's no arithmetic
+  assert(match("x-region = 'eu'"));
+  assert(match("priority = 5 AND priority = 5.0 AND priority = 0.5e1 AND priority > -1"));
+  assert(match("missing IS NULL"));
+  assert(match("type is not null And flag"));
+  assert(match("flag = TRUE AND flag = true"));
+  // bytes over 127 are only allowed inside quotes
+  assert(match("utf8 = '\xc3\xa9t\xc3\xa9'"));
+
+  assert(is_invalid(""));
+  assert(is_invalid("type = 'alert"));
+  assert(is_invalid("type = "));
+  assert(is_invalid("type == 'alert'"));
+  assert(is_invalid("priority = 1.2.3"));
+  assert(is_invalid("type = 'alert' extra"));
+  assert(is_invalid("\xc3\xa9t\xc3\xa9 = 'x'"));
+  assert(is_invalid("AND = 'x'"));
+  assert(is_invalid(std::string(stomp::Selector::kMaxLength + 1, ' ')));
+} // test_tokens
+
+// NULL is neither true nor false and only a true selector matches
+void test_logic() {
+  assert(!match("missing = 1"));
+  assert(!match("NOT (missing = 1)"));
+  assert(!match("missing <> 1"));
+  assert(match("missing = 1 OR TRUE"));
+  assert(!match("missing = 1 OR FALSE"));
+  assert(!match("missing = 1 AND TRUE"));
+  assert(match("NOT (missing = 1 AND FALSE)"));
+  assert(match("missing IS NULL AND NOT (missing IS NOT NULL)"));
+
+  // a value that isn't a number doesn't compare as one
+  assert(!match("type > 1") && !match("NOT (type > 1)"));
+  assert(match("priority > 4 AND priority < 6 AND priority >= 5 AND priority <= 5"));
+  assert(match("type > 'aaa' AND type < 'b'"));
+  assert(match("flag"));
+} // test_logic
+
+void test_like() {
+  assert(match("type LIKE 'alert'"));
+  assert(match("type LIKE 'al%'"));
+  assert(match("type LIKE '%rt'"));
+  assert(match("type LIKE '%'"));
+  assert(match("type LIKE '_l_r_'"));
+  assert(match("type LIKE '%%e%%'"));
+  assert(!match("type LIKE 'alert_'"));
+  assert(match("type NOT LIKE 'info%'"));
+  assert(match("path LIKE 'a\\_%' ESCAPE '\\'"));
+  assert(match("path LIKE 'a!_b!%_' ESCAPE '!'"));
+  assert(!match("path LIKE 'a!_c%' ESCAPE '!'"));
+  assert(match("path LIKE 'a__%c'"));
+
+  // NULL stays NULL even negated
+  assert(!match("missing LIKE '%'") && !match("missing NOT LIKE '%'"));
+
+  assert(is_invalid("type LIKE 'a!' ESCAPE '!'"));
+  assert(is_invalid("type LIKE 'a' ESCAPE '!!'"));
+  assert(is_invalid("type LIKE alert"));
+} // test_like
+
+void test_between_in() {
+  assert(match("priority BETWEEN 1 AND 5"));
+  assert(match("priority BETWEEN 5 AND 5"));
+  assert(!match("priority BETWEEN 6 AND 9"));
+  assert(match("priority NOT BETWEEN 6 AND 9"));
+  assert(match("type BETWEEN 'a' AND 'b'"));
+  // one unknown bound can still rule it out
+  assert(!match("priority BETWEEN missing AND 9") && !match("NOT (priority BETWEEN missing AND 9)"));
+  assert(match("NOT (priority BETWEEN missing AND 3)"));
+
+  assert(match("x-region IN ('us', 'eu')"));
+  assert(!match("x-region IN ('us', 'asia')"));
+  assert(match("x-region NOT IN ('us', 'asia')"));
+  assert(!match("missing IN ('us')") && !match("missing NOT IN ('us')"));
+
+  assert(is_invalid("x-region IN ()"));
+  assert(is_invalid("x-region IN ('us',)"));
+  assert(is_invalid("priority BETWEEN 1"));
+  assert(is_invalid("priority NOT = 1"));
+} // test_between_in
+
+// the stack is sized from the deepest point the compiler saw
+void test_depth() {
+  assert(stomp::Selector("type = 'alert'").depth() == 2);
+  assert(stomp::Selector("priority BETWEEN 1 AND 5").depth() == 3);
+  assert(stomp::Selector("a = 1 OR b = 1 OR c = 1 OR d = 1").depth() == 3);
+
+  // nesting to the right keeps every left hand side on the stack
+  std::string expr;
+  for(size_t i=0; i < stomp::Selector::kMaxNesting; i++) expr += "missing = 1 OR (";
+  expr += "type = 'alert'";
+  expr += std::string(stomp::Selector::kMaxNesting, ')');
+  stomp::Selector selector(expr);
+  assert(selector.depth() == stomp::Selector::kMaxNesting + 2);
+  assert(selector.match(_headers));
+
+  assert(is_invalid("(" + expr + ")"));
+  assert(is_invalid(std::string(stomp::Selector::kMaxNesting + 1, '(') + "flag" + std::string(stomp::Selector::kMaxNesting + 1, ')')));
+  std::string nots;
+  for(size_t i=0; i <= stomp::Selector::kMaxNesting; i++) nots += "NOT ";
+  assert(is_invalid(nots + "flag"));
+} // test_depth
+
+stomp::StompMessage *message(const std::string &type) {
+  stomp::StompMessage *smesg = new stomp::StompMessage("queue/selectortest", "body");
+  smesg->add_header("type", type);
+  return smesg;
+} // message
+
+// messages nobody selects are dropped, ones a busy sub selects wait for it
+void test_fanout() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  stomp::StompPeer *peer = new stomp::StompPeer(-1);
+  stomp::Exchange *exch = manager->create_exchange("queue/selectortest", stomp::Exchange::exchangeTypeFanout);
+
+  stomp::Subscription *alerts = new stomp::Subscription(peer, "alerts", "queue/selectortest", stomp::Subscription::ackModeClientIndv);
+  alerts->selector("type = 'alert'").prefetch(2);
+  stomp::Subscription *infos = new stomp::Subscription(peer, "infos", "queue/selectortest");
+  infos->selector("type IN ('info', 'debug')");
+  assert(exch->bind(alerts) && exch->bind(infos));
+
+  const char *types[] = { "alert", "noise", "info", "noise", "debug", "alert" };
+  for(size_t i=0; i < sizeof(types) / sizeof(char *); i++) {
+    stomp::StompMessage *smesg = message(types[i]);
+    exch->post(smesg);
+    smesg->release();
+  } // for
+  manager->dispatch_exchanges();
+
+  // the noise went nowhere and everyone got only what they asked for
+  assert(exch->sendq_size() == 0 && !exch->is_parked());
+  assert(alerts->sendq() == 2 && infos->sendq() == 2);
+
+  stomp::StompMessage *smesg;
+  while( alerts->dequeue_for_send(smesg) ) smesg->release();
+  assert(alerts->sentq() == 2 && !alerts->prefetch_ok());
+
+  // only alerts wants this and it's out of prefetch, the queue waits
+  smesg = message("alert");
+  exch->post(smesg);
+  smesg->release();
+  smesg = message("info");
+  exch->post(smesg);
+  smesg->release();
+  manager->dispatch_exchanges();
+  assert(exch->sendq_size() == 2 && exch->is_parked());
+  assert(alerts->sendq() == 0 && infos->sendq() == 2);
+
+  // nobody wants it once alerts is gone, the rest goes on to infos
+  exch->unbind(alerts);
+  manager->dispatch_exchanges();
+  assert(exch->sendq_size() == 0);
+  assert(infos->sendq() == 3);
+
+  exch->unbind(infos);
+  alerts->release();
+  infos->release();
+  peer->release();
+  manager->release();
+} // test_fanout
+
+int main(int argc, char **argv) {
+  _headers = new stomp::StompFrame("SEND");
+  _headers->add_header("type", "alert");
+  _headers->add_header("priority", "5");
+  _headers->add_header("flag", "true");
+  _headers->add_header("x-region", "eu");
+  _headers->add_header("x-odd name", "yes");
+  _headers->add_header("quote", "it's");
+  _headers->add_header("path", "a_b%c");
+  _headers->add_header("utf8", "\xc3\xa9t\xc3\xa9");
+
+  test_tokens();
+  test_logic();
+  test_like();
+  test_between_in();
+  test_depth();
+  test_fanout();
+
+  _headers->release();
+  std::cout << "selectortest ok" << std::endl;
+  exit(0);
+} // main
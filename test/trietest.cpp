@@ -0,0 +1,135 @@
+#include <cassert>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "StompPeer.h"
+#include "Subscription.h"
+#include "SubscriptionTrie.h"
+
+// Inserts and removes random literal and glob keys and checks every
+// lookup against globbing each subscription in turn.
+typedef stomp::SubscriptionTrie::list_t list_t;
+
+stomp::StompPeer *_peer;
+
+std::string randkey(const bool glob) {
+  static const char *segments[] = { "a", "b", "ab", "feeds", "x1" };
+  static const char *globs[] = { "*", "a*", "?", "*b", "x?" };
+  const size_t num_segments = sizeof(segments) / sizeof(char *);
+
+  std::string ret = "topic";
+  size_t depth = 1 + rand() % 4;
+  for(size_t i=0; i < depth; i++) {
+    ret += ".";
+    ret += (glob && rand() % 3 == 0 ? globs[rand() % 5] : segments[rand() % num_segments]);
+  } // for
+  return ret;
+} // randkey
+
+void check(const stomp::SubscriptionTrie &trie, const list_t &subs, const std::string &key) {
+  list_t want;
+  for(size_t i=0; i < subs.size(); i++) {
+    if ( subs[i]->match(key) ) want.push_back(subs[i]);
+  } // for
+
+  list_t got;
+  assert(trie.match(key, got) == got.size());
+  std::sort(want.begin(), want.end());
+  std::sort(got.begin(), got.end());
+  assert(got == want);
+} // check
+
+void test_random(const size_t num_ops) {
+  stomp::SubscriptionTrie trie;
+  list_t subs;
+
+  for(size_t op=0; op < num_ops; op++) {
+    if (subs.empty() || rand() % 3) {
+      stomp::Subscription *sub = new stomp::Subscription(_peer, "trietest", randkey(true));
+      assert(trie.insert(sub));
+      subs.push_back(sub);
+    } // if
+    else {
+      size_t i = rand() % subs.size();
+      stomp::Subscription *sub = subs[i];
+      assert(trie.remove(sub));
+      // gone, a second remove finds nothing
+      assert(!trie.remove(sub));
+      subs.erase(subs.begin() + i);
+      sub->release();
+    } // else
+
+    assert(trie.size() == subs.size());
+    for(size_t i=0; i < 10; i++) check(trie, subs, randkey(false));
+  } // for
+
+  for(size_t i=0; i < subs.size(); i++) {
+    assert(trie.remove(subs[i]));
+    subs[i]->release();
+  } // for
+  assert(trie.size() == 0);
+} // test_random
+
+void test_edges() {
+  stomp::SubscriptionTrie trie;
+  stomp::Subscription *deep = new stomp::Subscription(_peer, "deep", "topic.a.b.c");
+  stomp::Subscription *shallow = new stomp::Subscription(_peer, "shallow", "topic.a");
+  stomp::Subscription *glob = new stomp::Subscription(_peer, "glob", "topic.*");
+  stomp::Subscription *stranger = new stomp::Subscription(_peer, "stranger", "topic.a.b");
+
+  assert(trie.insert(deep) && trie.insert(shallow) && trie.insert(glob));
+  list_t ret;
+  assert(trie.match("topic.a", ret) == 2);
+  assert(trie.match("topic.a.b", ret) == 1);
+  assert(trie.match("topic.a.b.c", ret) == 2);
+  assert(trie.match("topic", ret) == 0);
+  assert(trie.match("", ret) == 0);
+
+  // a key whose path exists but which was never inserted
+  assert(!trie.remove(stranger));
+
+  // pruning the deep branch leaves the shallow key alone
+  assert(trie.remove(deep));
+  ret.clear();
+  assert(trie.match("topic.a", ret) == 2);
+  assert(trie.match("topic.a.b.c", ret) == 1 && ret.back() == glob);
+
+  assert(trie.remove(glob) && trie.remove(shallow));
+  assert(trie.size() == 0);
+  ret.clear();
+  assert(trie.match("topic.a", ret) == 0);
+
+  // clear() drops everything without touching the subs
+  assert(trie.insert(deep) && trie.insert(glob));
+  trie.clear();
+  assert(trie.size() == 0 && trie.match("topic.a.b.c", ret) == 0);
+
+  deep->release();
+  shallow->release();
+  glob->release();
+  stranger->release();
+} // test_edges
+
+int main(int argc, char **argv) {
+  srand(1);
+  _peer = new stomp::StompPeer(-1);
+
+  test_edges();
+  for(size_t i=0; i < 50; i++) test_random(100);
+
+  _peer->release();
+  std::cout << "trietest ok" << std::endl;
+  exit(0);
+} // main
@@ -0,0 +1,133 @@
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openframe/openframe.h>
+
+#include "ExchangeManager.h"
+#include "StompMessage.h"
+#include "StompPeer.h"
+#include "Subscription.h"
+
+// Checks each dispatch pass splits between exchanges by their weights
+// and a spent time budget only ever defers exchanges, never drops them.
+typedef std::vector<stomp::Exchange *> exchanges_t;
+typedef std::vector<stomp::Subscription *> subscriptions_t;
+
+stomp::StompPeer *_peer;
+
+void post(stomp::Exchange *exch, const size_t num) {
+  for(size_t i=0; i < num; i++) {
+    stomp::StompMessage *smesg = new stomp::StompMessage(exch->key(), "body");
+    exch->post(smesg);
+    smesg->release();
+  } // for
+} // post
+
+// one queue per weight, each with a sub that takes everything
+void setup(stomp::ExchangeManager *manager, const std::vector<size_t> &weights, exchanges_t &exchanges, subscriptions_t &subs) {
+  for(size_t i=0; i < weights.size(); i++) {
+    std::stringstream s;
+    s << "queue/weighttest." << i;
+    stomp::Exchange *exch = manager->create_exchange(s.str(), stomp::Exchange::exchangeTypeFanout);
+    exch->set_weight(weights[i]);
+    stomp::Subscription *sub = new stomp::Subscription(_peer, "weighttest", s.str());
+    assert(exch->bind(sub));
+    exchanges.push_back(exch);
+    subs.push_back(sub);
+  } // for
+} // setup
+
+void teardown(exchanges_t &exchanges, subscriptions_t &subs) {
+  for(size_t i=0; i < exchanges.size(); i++) {
+    exchanges[i]->unbind(subs[i]);
+    subs[i]->release();
+  } // for
+} // teardown
+
+void test_weights() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  std::vector<size_t> weights;
+  weights.push_back(1);
+  weights.push_back(3);
+  weights.push_back(0);		// taken as 1
+  exchanges_t exchanges;
+  subscriptions_t subs;
+  setup(manager, weights, exchanges, subs);
+  assert(exchanges[2]->weight() == 1);
+
+  const size_t limit = stomp::ExchangeManager::kDispatchLimit;
+  for(size_t i=0; i < exchanges.size(); i++) post(exchanges[i], 10 * limit);
+
+  manager->dispatch_exchanges();
+  assert(subs[0]->sendq() == limit && subs[1]->sendq() == 3 * limit && subs[2]->sendq() == limit);
+  manager->dispatch_exchanges();
+  assert(subs[0]->sendq() == 2 * limit && subs[1]->sendq() == 6 * limit && subs[2]->sendq() == 2 * limit);
+
+  // the heavy one runs dry, the rest keep their own share
+  for(size_t i=0; i < 3; i++) manager->dispatch_exchanges();
+  assert(exchanges[1]->sendq_size() == 0);
+  assert(subs[0]->sendq() == 5 * limit && subs[1]->sendq() == 10 * limit && subs[2]->sendq() == 5 * limit);
+
+  teardown(exchanges, subs);
+  manager->release();
+} // test_weights
+
+// weights set ahead are picked up by the exchange when it's made
+void test_preset() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  manager->set_weight("queue/weighttest.preset", 5);
+  stomp::Exchange *exch = manager->create_exchange("queue/weighttest.preset", stomp::Exchange::exchangeTypeFanout);
+  assert(exch->weight() == 5);
+  manager->set_weight("queue/weighttest.preset", 2);
+  assert(exch->weight() == 2);
+  manager->release();
+} // test_preset
+
+// a budget spent straight away still moves one exchange per pass, the
+// others wait their turn and all of them get through in the end
+void test_budget() {
+  stomp::ExchangeManager *manager = new stomp::ExchangeManager();
+  manager->set_dispatch_budget(1e-9);
+  std::vector<size_t> weights(5, 1);
+  exchanges_t exchanges;
+  subscriptions_t subs;
+  setup(manager, weights, exchanges, subs);
+
+  for(size_t i=0; i < exchanges.size(); i++) post(exchanges[i], 10);
+
+  for(size_t pass=1; pass <= exchanges.size(); pass++) {
+    manager->dispatch_exchanges();
+    size_t num_done = 0;
+    for(size_t i=0; i < subs.size(); i++) {
+      if (subs[i]->sendq() == 10) num_done++;
+    } // for
+    assert(num_done >= pass);
+  } // for
+  assert(manager->runq_size() == 0);
+
+  teardown(exchanges, subs);
+  manager->release();
+} // test_budget
+
+int main(int argc, char **argv) {
+  _peer = new stomp::StompPeer(-1);
+
+  test_weights();
+  test_preset();
+  test_budget();
+
+  _peer->release();
+  std::cout << "weighttest ok" << std::endl;
+  exit(0);
+} // main